@@ -0,0 +1,266 @@
+#ifndef BVH_H
+#define BVH_H
+//==============================================================================================
+// Originally written in 2016 by Peter Shirley <ptrshrl@gmail.com>
+//
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+
+enum class bvh_split {
+    random_axis,  // Median split along a randomly chosen axis
+    sah           // Binned surface area heuristic
+};
+
+
+struct bvh_primitive {
+    // Build-time record for one scene object. The builder reorders an array of these in place
+    // instead of copying the object list at every level.
+    size_t index;     // Index into the source object list
+    aabb box;
+    point3 centroid;
+};
+
+
+class bvh_node : public hittable  {
+    public:
+        bvh_node();
+
+        bvh_node(
+            const hittable_list& list, double time0, double time1,
+            bvh_split method = bvh_split::sah)
+            : bvh_node(list.objects, 0, list.objects.size(), time0, time1, method)
+        {}
+
+        bvh_node(
+            const std::vector<shared_ptr<hittable>>& src_objects,
+            size_t start, size_t end, double time0, double time1,
+            bvh_split method = bvh_split::sah);
+
+        bvh_node(
+            const std::vector<shared_ptr<hittable>>& src_objects,
+            std::vector<bvh_primitive>& primitives,
+            size_t start, size_t end, double time0, double time1, bvh_split method)
+        {
+            build(src_objects, primitives, start, end, time0, time1, method);
+        }
+
+        virtual bool hit(
+            const ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+        virtual bool occluded(const ray& r, double t_min, double t_max) const override;
+
+    public:
+        shared_ptr<hittable> left;
+        shared_ptr<hittable> right;
+        aabb box;
+
+    private:
+        void build(
+            const std::vector<shared_ptr<hittable>>& src_objects,
+            std::vector<bvh_primitive>& primitives,
+            size_t start, size_t end, double time0, double time1, bvh_split method);
+};
+
+
+inline aabb empty_box() {
+    return aabb(point3( infinity,  infinity,  infinity),
+                point3(-infinity, -infinity, -infinity));
+}
+
+
+std::vector<bvh_primitive> bvh_primitives(
+    const std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end,
+    double time0, double time1
+) {
+    std::vector<bvh_primitive> primitives;
+    primitives.reserve(end - start);
+
+    for (size_t i = start; i < end; i++) {
+        bvh_primitive prim;
+        prim.index = i;
+        if (!objects[i]->bounding_box(time0, time1, prim.box))
+            std::cerr << "No bounding box in bvh_node constructor.\n";
+        prim.centroid = 0.5 * (prim.box.min() + prim.box.max());
+        primitives.push_back(prim);
+    }
+
+    return primitives;
+}
+
+
+size_t bvh_split_median(
+    std::vector<bvh_primitive>& prims, size_t start, size_t end, int axis, bool by_centroid
+) {
+    // Partitions prims[start,end) around the median along the axis and returns the split point.
+    auto mid = start + (end - start)/2;
+    std::nth_element(prims.begin() + start, prims.begin() + mid, prims.begin() + end,
+        [axis, by_centroid](const bvh_primitive& a, const bvh_primitive& b) {
+            return by_centroid ? a.centroid.e[axis] < b.centroid.e[axis]
+                               : a.box.min().e[axis] < b.box.min().e[axis];
+        });
+    return mid;
+}
+
+
+size_t bvh_split_random_axis(std::vector<bvh_primitive>& prims, size_t start, size_t end) {
+    return bvh_split_median(prims, start, end, random_int(0,2), false);
+}
+
+
+size_t bvh_split_sah(std::vector<bvh_primitive>& prims, size_t start, size_t end) {
+    // Bins the primitive centroids along the longest axis of their bounds and splits at the bin
+    // boundary that minimizes (left count * left area) + (right count * right area).
+    const int bin_count = 12;
+
+    aabb centroid_bounds = empty_box();
+    for (size_t i = start; i < end; i++)
+        centroid_bounds = surrounding_box(
+            centroid_bounds, aabb(prims[i].centroid, prims[i].centroid));
+
+    int axis = centroid_bounds.longest_axis();
+    auto axis_min = centroid_bounds.min()[axis];
+    auto extent = centroid_bounds.max()[axis] - axis_min;
+
+    // All centroids coincide; there is nothing for the heuristic to separate.
+    if (extent <= 0)
+        return bvh_split_median(prims, start, end, axis, true);
+
+    auto bin_of = [=](const bvh_primitive& prim) {
+        auto b = static_cast<int>(bin_count * (prim.centroid[axis] - axis_min) / extent);
+        return std::min(b, bin_count-1);
+    };
+
+    size_t counts[bin_count] = {};
+    aabb bounds[bin_count];
+    for (int b = 0; b < bin_count; b++)
+        bounds[b] = empty_box();
+
+    for (size_t i = start; i < end; i++) {
+        auto b = bin_of(prims[i]);
+        counts[b]++;
+        bounds[b] = surrounding_box(bounds[b], prims[i].box);
+    }
+
+    // Sweep from the right to get the cost of every right-hand side, then from the left.
+    double right_cost[bin_count];
+    size_t right_count = 0;
+    aabb right_box = empty_box();
+    for (int b = bin_count-1; b > 0; b--) {
+        right_count += counts[b];
+        right_box = surrounding_box(right_box, bounds[b]);
+        right_cost[b] = right_count ? right_count * right_box.area() : 0;
+    }
+
+    int best_bin = -1;
+    auto best_cost = infinity;
+    size_t left_count = 0;
+    aabb left_box = empty_box();
+    for (int b = 0; b < bin_count-1; b++) {
+        left_count += counts[b];
+        left_box = surrounding_box(left_box, bounds[b]);
+        if (left_count == 0 || left_count == end - start)
+            continue;
+
+        auto cost = left_count * left_box.area() + right_cost[b+1];
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_bin = b;
+        }
+    }
+
+    if (best_bin < 0)
+        return bvh_split_median(prims, start, end, axis, true);
+
+    auto middle = std::partition(prims.begin() + start, prims.begin() + end,
+        [&](const bvh_primitive& prim) { return bin_of(prim) <= best_bin; });
+
+    return static_cast<size_t>(middle - prims.begin());
+}
+
+
+bvh_node::bvh_node(
+    const std::vector<shared_ptr<hittable>>& src_objects,
+    size_t start, size_t end, double time0, double time1, bvh_split method
+) {
+    auto primitives = bvh_primitives(src_objects, start, end, time0, time1);
+    build(src_objects, primitives, 0, primitives.size(), time0, time1, method);
+}
+
+
+void bvh_node::build(
+    const std::vector<shared_ptr<hittable>>& src_objects,
+    std::vector<bvh_primitive>& primitives,
+    size_t start, size_t end, double time0, double time1, bvh_split method
+) {
+    size_t object_span = end - start;
+
+    if (object_span == 1) {
+        left = right = src_objects[primitives[start].index];
+    } else if (object_span == 2) {
+        left = src_objects[primitives[start].index];
+        right = src_objects[primitives[start+1].index];
+    } else {
+        auto mid = (method == bvh_split::sah)
+                 ? bvh_split_sah(primitives, start, end)
+                 : bvh_split_random_axis(primitives, start, end);
+
+        left = make_shared<bvh_node>(
+            src_objects, primitives, start, mid, time0, time1, method);
+        right = make_shared<bvh_node>(
+            src_objects, primitives, mid, end, time0, time1, method);
+    }
+
+    aabb box_left, box_right;
+
+    if (  !left->bounding_box (time0, time1, box_left)
+       || !right->bounding_box(time0, time1, box_right)
+    )
+        std::cerr << "No bounding box in bvh_node constructor.\n";
+
+    box = surrounding_box(box_left, box_right);
+}
+
+
+bool bvh_node::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    if (!box.hit(r, t_min, t_max))
+        return false;
+
+    bool hit_left = left->hit(r, t_min, t_max, rec);
+    bool hit_right = right->hit(r, t_min, hit_left ? rec.t : t_max, rec);
+
+    return hit_left || hit_right;
+}
+
+
+bool bvh_node::occluded(const ray& r, double t_min, double t_max) const {
+    if (!box.hit(r, t_min, t_max))
+        return false;
+
+    return left->occluded(r, t_min, t_max) || right->occluded(r, t_min, t_max);
+}
+
+
+bool bvh_node::bounding_box(double time0, double time1, aabb& output_box) const {
+    output_box = box;
+    return true;
+}
+
+
+#endif
@@ -17,20 +17,20 @@ class directional_light : public light {
         directional_light(color color_light, vec3 dir_light) {
             col_light = color_light;
             dir = dir_light;
+            light_vec = unit_vector(-1.0 * dir);
         }
 
         /* get the unitary light vector, starting from fragment
          */
         vec3 get_light_vector() const {
-            return unit_vector(-1.0 * dir);
+            return light_vec;
         }
 
         virtual bool compute_color(
             const hittable_list& world, const ray& r, const hit_record& rec, color& col
         ) const override {
-            ray shadow_ray = ray(rec.p, get_light_vector());
-            hit_record shadow_ray_hit_rec;
-            bool if_under_shadow = world.hit(shadow_ray, 0.001, infinity, shadow_ray_hit_rec);
+            ray shadow_ray = ray(rec.p, light_vec);
+            bool if_under_shadow = world.occluded(shadow_ray, 0.001, infinity);
             if (if_under_shadow) {
                 // if hit point is under shadow, set col to black and return false
                 col = color(0,0,0);
@@ -40,7 +40,6 @@ class directional_light : public light {
                 // if hit point is not under shadow, set col based on Phong-Blinn model,
                 // and return true
                 // modifed from shading assignment
-                vec3 light_vec = get_light_vector();
                 vec3 normal_vec = unit_vector(rec.normal);
                 
                 // compute diffuse component
@@ -85,6 +84,7 @@ class directional_light : public light {
     public:
         color col_light;
         vec3 dir;
+        vec3 light_vec; // unitary, -dir; cached since every shading call needs it
 };
 
 #endif
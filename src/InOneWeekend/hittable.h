@@ -13,14 +13,19 @@
 
 #include "rtweekend.h"
 
+#include "aabb.h"
+
+
 class material;
 
 
 struct hit_record {
     point3 p;
     vec3 normal;
-    shared_ptr<material> mat_ptr;
+    material* mat_ptr;  // Not owned; the object that was hit keeps its material alive
     double t;
+    double u;
+    double v;
     bool front_face;
 
     inline void set_face_normal(const ray& r, const vec3& outward_normal) {
@@ -33,6 +38,15 @@ struct hit_record {
 class hittable {
     public:
         virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const = 0;
+
+        // Returns whether anything lies along r between t_min and t_max. Unlike hit, it may
+        // stop at the first intersection found and fills in no record, which is all a shadow
+        // ray needs.
+        virtual bool occluded(const ray& r, double t_min, double t_max) const {
+            hit_record rec;
+            return hit(r, t_min, t_max, rec);
+        }
 };
 
 
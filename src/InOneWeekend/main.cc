@@ -11,8 +11,11 @@
 
 #include "rtweekend.h"
 
+#include "bvh.h"
 #include "camera.h"
 #include "color.h"
+#include "framebuffer.h"
+#include "image_output.h"
 #include "hittable_list.h"
 #include "material.h"
 #include "sphere.h"
@@ -20,10 +23,14 @@
 #include "torus.h"
 #include "light.h"
 #include "light_list.h"
+#include "mesh_loader.h"
 #include "point_light.h"
 #include "directional_light.h"
+#include "tile_renderer.h"
 
+#include <cstring>
 #include <iostream>
+#include <string>
 
 struct world_and_lights
 {
@@ -31,17 +38,28 @@ struct world_and_lights
     light_list lights;
 };
 
-color ray_color(const ray& r, const world_and_lights& world_and_lights, int depth) {
-    hit_record rec;
-
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-        return color(0,0,0);
+color ray_color(const ray& r, const world_and_lights& world_and_lights, int max_depth, int rr_depth) {
+    // follows the path iteratively, carrying the product of the weights of the global color
+    // so far as its throughput. After rr_depth bounces, Russian roulette ends each path with a
+    // probability that grows as its throughput falls, and scales up the survivors to keep the
+    // estimate unbiased
+    color radiance(0,0,0);
+    color throughput(1,1,1);
+    ray current = r;
+
+    for (int depth = 0; depth < max_depth; depth++) {
+        hit_record rec;
+
+        if (!world_and_lights.world.hit(current, 0.001, infinity, rec)) {
+            vec3 unit_direction = unit_vector(current.direction());
+            auto t = 0.5*(unit_direction.y() + 1.0);
+            return radiance + throughput * ((1.0-t)*color(1.0, 1.0, 1.0) + t*color(0.5, 0.7, 1.0));
+        }
 
-    if (world_and_lights.world.hit(r, 0.001, infinity, rec)) {
         // computes local color
         color color_local = color(0,0,0);
-        bool if_not_under_shadow = world_and_lights.lights.compute_color(world_and_lights.world, r, rec, color_local);
+        bool if_not_under_shadow = world_and_lights.lights.compute_color(world_and_lights.world, current, rec, color_local);
+        radiance += throughput * color_local;
 
         // sets contribution of global color. if under 
         // shadow, then little global contribution
@@ -50,22 +68,29 @@ color ray_color(const ray& r, const world_and_lights& world_and_lights, int dept
             contribution = 0.4;
         }
 
-        // if the hit point is not under shadow, keep tracing
         ray scattered;
         color attenuation;
-        if (rec.mat_ptr->scatter(r, rec, attenuation, scattered)) {
-            // scatter ray is produced, keep tracing
-            return color_local + contribution * attenuation * ray_color(scattered, world_and_lights, depth-1);
-        }
-        else {
+        if (!rec.mat_ptr->scatter(current, rec, attenuation, scattered)) {
             // no scatter ray, return color under light
-            return color_local;
+            return radiance;
+        }
+
+        // scatter ray is produced, keep tracing
+        throughput = contribution * throughput * attenuation;
+
+        if (depth + 1 >= rr_depth) {
+            auto survival = fmin(fmax(throughput.x(), fmax(throughput.y(), throughput.z())), 0.95);
+            if (random_double() >= survival) {
+                return radiance;
+            }
+            throughput /= survival;
         }
+
+        current = scattered;
     }
 
-    vec3 unit_direction = unit_vector(r.direction());
-    auto t = 0.5*(unit_direction.y() + 1.0);
-    return (1.0-t)*color(1.0, 1.0, 1.0) + t*color(0.5, 0.7, 1.0);
+    // If we've exceeded the ray bounce limit, no more light is gathered.
+    return radiance;
 }
 
 
@@ -218,7 +243,8 @@ struct world_and_lights random_scene_with_cubes() {
     light_list lights;
     lights.add(make_shared<point_light>(color(1, 1, 1), point3(10, 4, 3)));
 
-    world_and_lights.world = world;
+    // the objects are wrapped in a BVH so rays only test the objects whose boxes they hit
+    world_and_lights.world = hittable_list(make_shared<bvh_node>(world, 0, 1));
     world_and_lights.lights = lights;
     return world_and_lights;
 }
@@ -305,13 +331,59 @@ struct world_and_lights random_scene_with_everything() {
     light_list lights;
     lights.add(make_shared<point_light>(color(1, 1, 1), point3(20, 6, 3)));
 
+    // the objects are wrapped in a BVH so rays only test the objects whose boxes they hit
+    world_and_lights.world = hittable_list(make_shared<bvh_node>(world, 0, 1));
+    world_and_lights.lights = lights;
+    return world_and_lights;
+}
+
+
+struct world_and_lights scene_with_mesh(const std::string& filename) {
+    struct world_and_lights world_and_lights;
+
+    // an empty world tells the caller the mesh could not be loaded
+    mesh_data mesh;
+    if (!load_mesh(filename, mesh) || mesh.vertices.empty()) {
+        return world_and_lights;
+    }
+
+    // scale the mesh to a height of 2 and stand it on the ground at the origin
+    point3 small = mesh.vertices[0];
+    point3 big = mesh.vertices[0];
+    for (const auto& vertex : mesh.vertices) {
+        for (int a = 0; a < 3; a++) {
+            small[a] = fmin(small[a], vertex[a]);
+            big[a] = fmax(big[a], vertex[a]);
+        }
+    }
+    double scale = 2.0 / fmax(big.y() - small.y(), 1e-8);
+    point3 base(0.5*(small.x() + big.x()), small.y(), 0.5*(small.z() + big.z()));
+    for (auto& vertex : mesh.vertices) {
+        vertex = scale * (vertex - base);
+    }
+
+    // create world
+    hittable_list world;
+
+    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
+
+    // diffuse
+    shared_ptr<material> mesh_material = make_shared<lambertian>(color(0.5, 0.1, 0.1));
+    world.add(make_shared<triangle_mesh>(
+        std::move(mesh.vertices), std::move(mesh.indices), mesh_material));
+
+    // create lights
+    light_list lights;
+    lights.add(make_shared<point_light>(color(1, 1, 1), point3(13, 4, 1)));
+
     world_and_lights.world = world;
     world_and_lights.lights = lights;
     return world_and_lights;
 }
 
 
-int main() {
+int main(int argc, char* argv[]) {
 
     // Image
 
@@ -320,16 +392,33 @@ int main() {
     const int image_height = static_cast<int>(image_width / aspect_ratio);
     const int samples_per_pixel = 10;
     const int max_depth = 10;
+    const int rr_depth = 3;  // bounces before Russian roulette may end a path
+
+    // Command line: an optional output file, and --mesh <file> to render an OBJ or PLY mesh
+    // instead of the default scene.
+
+    const char* output_file = nullptr;
+    const char* mesh_file = nullptr;
+
+    for (int arg = 1; arg < argc; ++arg) {
+        if (std::strcmp(argv[arg], "--mesh") == 0 && arg+1 < argc)
+            mesh_file = argv[++arg];
+        else
+            output_file = argv[arg];
+    }
 
     // World
 
     //auto world_and_lights = random_scene_with_spheres();
     //auto world_and_lights = scene_with_cube();
     //auto world_and_lights = scene_with_sphere();
-    auto world_and_lights = random_scene_with_cubes();
+    auto world_and_lights = mesh_file ? scene_with_mesh(mesh_file) : random_scene_with_cubes();
     //auto world_and_lights = scene_with_torus();
     //auto world_and_lights = random_scene_with_everything();
 
+    if (world_and_lights.world.objects.empty())
+        return 1;
+
     // Camera
 
     point3 lookfrom(13,2,3);
@@ -342,21 +431,35 @@ int main() {
 
     // Render
 
-    std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-
-    for (int j = image_height-1; j >= 0; --j) {
-        std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
-        for (int i = 0; i < image_width; ++i) {
-            color pixel_color(0,0,0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = (i + random_double()) / (image_width-1);
-                auto v = (j + random_double()) / (image_height-1);
-                ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, world_and_lights, max_depth);
+    const std::uint64_t render_seed = 0;
+
+    framebuffer image(image_width, image_height);
+    tile_renderer renderer(image_width, image_height);
+
+    renderer.render([&](const tile& t) {
+        for (int j = t.y0; j < t.y1; ++j) {
+            for (int i = t.x0; i < t.x1; ++i) {
+                // Seeding per pixel makes the image independent of the thread count.
+                thread_rng().seed_stream(render_seed, static_cast<std::uint64_t>(j)*image_width + i);
+
+                color pixel_color(0,0,0);
+                for (int s = 0; s < samples_per_pixel; ++s) {
+                    auto u = (i + random_double()) / (image_width-1);
+                    auto v = (j + random_double()) / (image_height-1);
+                    ray r = cam.get_ray(u, v);
+                    pixel_color += ray_color(r, world_and_lights, max_depth, rr_depth);
+                }
+                image.at(i,j) = pixel_color;
             }
-            write_color(std::cout, pixel_color, samples_per_pixel);
         }
-    }
+    });
+
+    // Write the image to the file named on the command line, in the format given by its
+    // extension, or as binary PPM to standard output.
+    bool written = output_file ? write_image(output_file, image, samples_per_pixel)
+                               : write_ppm(image, samples_per_pixel);
+    if (!written)
+        return 1;
 
     std::cerr << "\nDone.\n";
 }
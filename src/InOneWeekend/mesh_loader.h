@@ -0,0 +1,547 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "triangle_mesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define RTW_HAVE_MMAP 1
+#endif
+
+
+struct mesh_data {
+    std::vector<point3> vertices;
+    std::vector<std::uint32_t> indices;  // three per triangle
+};
+
+
+class mapped_file {
+    /* read-only view of a whole file: memory mapped where the platform supports it, otherwise
+     * read into memory
+     */
+    public:
+        mapped_file(const std::string& filename) {
+            #ifdef RTW_HAVE_MMAP
+                int fd = open(filename.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    return;
+                }
+                struct stat info;
+                if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                    void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (view != MAP_FAILED) {
+                        // the parsers make one pass from front to back
+                        madvise(view, info.st_size, MADV_SEQUENTIAL);
+                        mapping = static_cast<const char*>(view);
+                        length = static_cast<size_t>(info.st_size);
+                        opened = true;
+                    }
+                }
+                close(fd);
+                if (opened) {
+                    return;
+                }
+            #endif
+
+            std::ifstream in(filename, std::ios::binary | std::ios::ate);
+            if (!in) {
+                return;
+            }
+            buffer.resize(static_cast<size_t>(in.tellg()));
+            in.seekg(0);
+            in.read(buffer.data(), buffer.size());
+            length = buffer.size();
+            opened = static_cast<bool>(in);
+        }
+
+        ~mapped_file() {
+            #ifdef RTW_HAVE_MMAP
+                if (mapping) {
+                    munmap(const_cast<char*>(mapping), length);
+                }
+            #endif
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        bool is_open() const { return opened; }
+        const char* data() const { return mapping ? mapping : buffer.data(); }
+        size_t size() const { return length; }
+
+    private:
+        const char* mapping = nullptr;
+        std::vector<char> buffer;
+        size_t length = 0;
+        bool opened = false;
+};
+
+
+/* number parsing straight from the file contents, which need not be null terminated */
+
+inline void skip_blanks(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+}
+
+inline void skip_line(const char*& p, const char* end) {
+    while (p < end && *p != '\n') {
+        p++;
+    }
+    if (p < end) {
+        p++;
+    }
+}
+
+inline bool parse_int(const char*& p, const char* end, long long& value) {
+    skip_blanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return false;
+    }
+    // a number too large for a long long is an error, not a wrapped-around index
+    const long long largest = std::numeric_limits<long long>::max();
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        int digit = *p - '0';
+        if (value > (largest - digit) / 10) {
+            return false;
+        }
+        value = 10*value + digit;
+        p++;
+    }
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+
+inline bool parse_double(const char*& p, const char* end, double& value) {
+    skip_blanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    // accumulate up to 18 significant digits as an integer, counting the rest in the exponent
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digits = false;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 18) {
+            mantissa = 10*mantissa + (*p - '0');
+            if (mantissa > 0) digits++;
+        } else {
+            exponent++;
+        }
+        any_digits = true;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 18) {
+                mantissa = 10*mantissa + (*p - '0');
+                if (mantissa > 0) digits++;
+                exponent--;
+            }
+            any_digits = true;
+            p++;
+        }
+    }
+    if (!any_digits) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        long long e;
+        if (!parse_int(p, end, e)) {
+            return false;
+        }
+        // any exponent beyond +-1000 already over- or underflows a double
+        exponent += static_cast<int>(std::max(-1000LL, std::min(e, 1000LL)));
+    }
+
+    value = static_cast<double>(mantissa);
+    if (exponent != 0) {
+        value *= std::pow(10.0, exponent);
+    }
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+
+
+/* adds the polygon with the given vertex indices as a fan of triangles */
+inline void add_polygon(
+    const std::vector<std::uint32_t>& polygon, std::vector<std::uint32_t>& indices
+) {
+    for (size_t i = 2; i < polygon.size(); i++) {
+        indices.push_back(polygon[0]);
+        indices.push_back(polygon[i-1]);
+        indices.push_back(polygon[i]);
+    }
+}
+
+
+/* Wavefront OBJ: reads the "v" and "f" lines and ignores everything else (normals, texture
+ * coordinates, groups and materials). Faces with more than three vertices are split into fans.
+ */
+bool parse_obj(const char* data, size_t size, mesh_data& mesh) {
+    const char* p = data;
+    const char* end = data + size;
+    std::vector<std::uint32_t> polygon;
+    long long line = 0;
+
+    while (p < end) {
+        line++;
+        skip_blanks(p, end);
+
+        if (end - p > 1 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            p++;
+            double x, y, z;
+            if (!parse_double(p, end, x) || !parse_double(p, end, y) || !parse_double(p, end, z)) {
+                std::cerr << "ERROR: Malformed vertex on line " << line << " of OBJ file.\n";
+                return false;
+            }
+            mesh.vertices.push_back(point3(x, y, z));
+        } else if (end - p > 1 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            p++;
+            polygon.clear();
+            while (true) {
+                skip_blanks(p, end);
+                if (p == end || *p == '\n') {
+                    break;
+                }
+                long long index;
+                if (!parse_int(p, end, index) || index == 0) {
+                    std::cerr << "ERROR: Malformed face on line " << line << " of OBJ file.\n";
+                    return false;
+                }
+                // indices are 1-based, or relative to the end of the vertex list if negative
+                if (index < 0) {
+                    index += static_cast<long long>(mesh.vertices.size());
+                } else {
+                    index -= 1;
+                }
+                if (index < 0 || index > UINT32_MAX) {
+                    std::cerr << "ERROR: Face index out of range on line " << line
+                              << " of OBJ file.\n";
+                    return false;
+                }
+                polygon.push_back(static_cast<std::uint32_t>(index));
+
+                // skip any "/texture/normal" references
+                while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+                    p++;
+                }
+            }
+            add_polygon(polygon, mesh.indices);
+        }
+
+        skip_line(p, end);
+    }
+
+    return true;
+}
+
+
+enum class ply_type { none, int8, uint8, int16, uint16, int32, uint32, float32, float64 };
+
+
+inline ply_type ply_type_from_name(const std::string& name) {
+    if (name == "char"   || name == "int8")    return ply_type::int8;
+    if (name == "uchar"  || name == "uint8")   return ply_type::uint8;
+    if (name == "short"  || name == "int16")   return ply_type::int16;
+    if (name == "ushort" || name == "uint16")  return ply_type::uint16;
+    if (name == "int"    || name == "int32")   return ply_type::int32;
+    if (name == "uint"   || name == "uint32")  return ply_type::uint32;
+    if (name == "float"  || name == "float32") return ply_type::float32;
+    if (name == "double" || name == "float64") return ply_type::float64;
+    return ply_type::none;
+}
+
+
+struct ply_property {
+    ply_type type;
+    ply_type count_type;  // not none for list properties
+    int coordinate;       // 0, 1, 2 for the vertex x, y, z; -1 otherwise
+    bool is_polygon;      // the face's vertex index list
+};
+
+
+struct ply_element {
+    std::string name;
+    size_t count;
+    std::vector<ply_property> properties;
+};
+
+
+class ply_reader {
+    /* reads binary PLY values, swapping bytes if the file's byte order differs from the
+     * machine's
+     */
+    public:
+        ply_reader(const char* p, const char* end, bool big_endian) : p(p), end(end) {
+            const std::uint16_t one = 1;
+            bool host_big_endian = *reinterpret_cast<const unsigned char*>(&one) == 0;
+            swap = (big_endian != host_big_endian);
+        }
+
+        bool read(ply_type type, double& value) {
+            switch (type) {
+                case ply_type::int8:    { std::int8_t v;   if (!get(v)) return false; value = v; break; }
+                case ply_type::uint8:   { std::uint8_t v;  if (!get(v)) return false; value = v; break; }
+                case ply_type::int16:   { std::int16_t v;  if (!get(v)) return false; value = v; break; }
+                case ply_type::uint16:  { std::uint16_t v; if (!get(v)) return false; value = v; break; }
+                case ply_type::int32:   { std::int32_t v;  if (!get(v)) return false; value = v; break; }
+                case ply_type::uint32:  { std::uint32_t v; if (!get(v)) return false; value = v; break; }
+                case ply_type::float32: { float v;         if (!get(v)) return false; value = v; break; }
+                case ply_type::float64: { double v;        if (!get(v)) return false; value = v; break; }
+                default:
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        template<typename T>
+        bool get(T& value) {
+            if (end - p < static_cast<std::ptrdiff_t>(sizeof(T))) {
+                return false;
+            }
+            unsigned char bytes[sizeof(T)];
+            std::memcpy(bytes, p, sizeof(T));
+            p += sizeof(T);
+            if (swap) {
+                for (size_t i = 0; i < sizeof(T)/2; i++) {
+                    std::swap(bytes[i], bytes[sizeof(T)-1-i]);
+                }
+            }
+            std::memcpy(&value, bytes, sizeof(T));
+            return true;
+        }
+
+    private:
+        const char* p;
+        const char* end;
+        bool swap;
+};
+
+
+/* binary PLY (either byte order): reads the x, y, z properties of the "vertex" element and the
+ * "vertex_indices" (or "vertex_index") list of the "face" element; other elements and
+ * properties are skipped
+ */
+bool parse_ply(const char* data, size_t size, mesh_data& mesh) {
+    const char* end = data + size;
+
+    // the header is plain text ending with an "end_header" line
+    const char* marker = "end_header";
+    const char* header_end = std::search(data, end, marker, marker + std::strlen(marker));
+    if (header_end == end || size < 4 || std::strncmp(data, "ply", 3) != 0) {
+        std::cerr << "ERROR: Missing PLY header.\n";
+        return false;
+    }
+    const char* body = header_end;
+    skip_line(body, end);
+
+    std::istringstream header(std::string(data, header_end));
+    std::vector<ply_element> elements;
+    bool big_endian = false;
+    std::string line;
+    while (std::getline(header, line)) {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            words >> format;
+            if (format == "binary_big_endian") {
+                big_endian = true;
+            } else if (format != "binary_little_endian") {
+                std::cerr << "ERROR: Unsupported PLY format '" << format << "'.\n";
+                return false;
+            }
+        } else if (keyword == "element") {
+            ply_element element;
+            words >> element.name >> element.count;
+            elements.push_back(element);
+        } else if (keyword == "property" && !elements.empty()) {
+            std::string type, count_type, name;
+            words >> type;
+            if (type == "list") {
+                words >> count_type >> type;
+            }
+            words >> name;
+
+            ply_property property;
+            property.type = ply_type_from_name(type);
+            property.count_type = count_type.empty() ? ply_type::none
+                                                     : ply_type_from_name(count_type);
+            if (property.type == ply_type::none
+                || (!count_type.empty() && property.count_type == ply_type::none)) {
+                std::cerr << "ERROR: Unknown PLY property type in '" << line << "'.\n";
+                return false;
+            }
+
+            const auto& element_name = elements.back().name;
+            property.coordinate = -1;
+            if (element_name == "vertex" && count_type.empty()) {
+                if (name == "x") property.coordinate = 0;
+                if (name == "y") property.coordinate = 1;
+                if (name == "z") property.coordinate = 2;
+            }
+            property.is_polygon = element_name == "face" && !count_type.empty()
+                               && (name == "vertex_indices" || name == "vertex_index");
+            elements.back().properties.push_back(property);
+        }
+    }
+
+    ply_reader reader(body, end, big_endian);
+    std::vector<std::uint32_t> polygon;
+
+    for (const auto& element : elements) {
+        bool is_vertex = (element.name == "vertex");
+        if (is_vertex) {
+            mesh.vertices.reserve(mesh.vertices.size() + element.count);
+        } else if (element.name == "face") {
+            mesh.indices.reserve(mesh.indices.size() + 3*element.count);
+        }
+
+        for (size_t n = 0; n < element.count; n++) {
+            double xyz[3] = { 0, 0, 0 };
+            for (const auto& property : element.properties) {
+                double value;
+                if (property.count_type == ply_type::none) {
+                    if (!reader.read(property.type, value)) {
+                        std::cerr << "ERROR: PLY file is truncated.\n";
+                        return false;
+                    }
+                    if (property.coordinate >= 0) {
+                        xyz[property.coordinate] = value;
+                    }
+                    continue;
+                }
+
+                double count;
+                if (!reader.read(property.count_type, count)) {
+                    std::cerr << "ERROR: PLY file is truncated.\n";
+                    return false;
+                }
+                polygon.clear();
+                for (long long i = 0; i < static_cast<long long>(count); i++) {
+                    if (!reader.read(property.type, value)) {
+                        std::cerr << "ERROR: PLY file is truncated.\n";
+                        return false;
+                    }
+                    if (property.is_polygon) {
+                        if (value < 0 || value > UINT32_MAX) {
+                            std::cerr << "ERROR: PLY face index " << value << " is out of range.\n";
+                            return false;
+                        }
+                        polygon.push_back(static_cast<std::uint32_t>(value));
+                    }
+                }
+                if (property.is_polygon) {
+                    add_polygon(polygon, mesh.indices);
+                }
+            }
+            if (is_vertex) {
+                mesh.vertices.push_back(point3(xyz[0], xyz[1], xyz[2]));
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/* loads an OBJ or binary PLY file, picking the format by extension, and reports the parse
+ * throughput to standard error
+ */
+bool load_mesh(const std::string& filename, mesh_data& mesh) {
+    auto start = std::chrono::steady_clock::now();
+
+    mapped_file file(filename);
+    if (!file.is_open()) {
+        std::cerr << "ERROR: Could not open mesh file '" << filename << "'.\n";
+        return false;
+    }
+
+    auto dot = filename.rfind('.');
+    auto extension = (dot == std::string::npos) ? std::string() : filename.substr(dot);
+
+    bool ok;
+    if (extension == ".obj") {
+        ok = parse_obj(file.data(), file.size(), mesh);
+    } else if (extension == ".ply") {
+        ok = parse_ply(file.data(), file.size(), mesh);
+    } else {
+        std::cerr << "ERROR: Unknown mesh file type '" << filename << "'.\n";
+        return false;
+    }
+    if (!ok) {
+        std::cerr << "ERROR: Could not parse mesh file '" << filename << "'.\n";
+        return false;
+    }
+
+    auto finish = std::chrono::steady_clock::now();
+    auto seconds = std::chrono::duration<double>(finish - start).count();
+    auto megabytes = file.size() / (1024.0 * 1024.0);
+    std::cerr << "Loaded " << filename << ": " << mesh.vertices.size() << " vertices, "
+              << mesh.indices.size() / 3 << " triangles, " << megabytes << " MB in "
+              << seconds << " s (" << megabytes / seconds << " MB/s)\n";
+    return true;
+}
+
+
+/* loads a mesh file straight into a triangle mesh; returns nullptr if it cannot be read */
+shared_ptr<triangle_mesh> load_triangle_mesh(
+    const std::string& filename, shared_ptr<material> m, bool watertight = false
+) {
+    mesh_data mesh;
+    if (!load_mesh(filename, mesh)) {
+        return nullptr;
+    }
+    return make_shared<triangle_mesh>(
+        std::move(mesh.vertices), std::move(mesh.indices), m, watertight);
+}
+
+
+#endif
@@ -28,9 +28,13 @@ class point_light : public light {
         virtual bool compute_color(
             const hittable_list& world, const ray& r, const hit_record& rec, color& col
         ) const override {
-            ray shadow_ray = ray(rec.p, get_light_vector(rec.p));
-            hit_record shadow_ray_hit_rec;
-            bool if_under_shadow = world.hit(shadow_ray, 0.001, infinity, shadow_ray_hit_rec);
+            // only geometry between the fragment and the light can cast a shadow, so the
+            // shadow ray stops at the light
+            vec3 to_light = pos - rec.p;
+            double light_distance = to_light.length();
+            vec3 light_vec = to_light / light_distance;
+            ray shadow_ray = ray(rec.p, light_vec);
+            bool if_under_shadow = world.occluded(shadow_ray, 0.001, light_distance);
             if (if_under_shadow) {
                 // if hit point is under shadow, set col to black and return false
                 col = color(0,0,0);
@@ -40,7 +44,6 @@ class point_light : public light {
                 // if hit point is not under shadow, set col based on Phong-Blinn model,
                 // and return true
                 // modifed from shading assignment
-                vec3 light_vec = get_light_vector(rec.p);
                 vec3 normal_vec = unit_vector(rec.normal);
                 
                 // compute diffuse component
@@ -9,6 +9,107 @@
 #include "hittable.h"
 
 
+/* polynomial root finders for the torus intersection; each stores the real roots in roots[]
+ * and returns how many there are
+ */
+
+/* x^2 + b*x + c = 0 */
+inline int solve_quadratic(double b, double c, double roots[2]) {
+    double p = b/2.0;
+    double discriminant = p*p - c;
+    if (discriminant < 0.0) {
+        return 0;
+    }
+    if (discriminant == 0.0) {
+        roots[0] = -p;
+        return 1;
+    }
+    double sqrt_d = sqrt(discriminant);
+    roots[0] = -p - sqrt_d;
+    roots[1] = -p + sqrt_d;
+    return 2;
+}
+
+/* x^3 + a*x^2 + b*x + c = 0, by Cardano's formula (trigonometric form for three roots) */
+inline int solve_cubic(double a, double b, double c, double roots[3]) {
+    // substitute x = y - a/3 to get y^3 + 3p*y + 2q = 0
+    double sq_a = a*a;
+    double p = (-sq_a/3.0 + b) / 3.0;
+    double q = (2.0/27.0*a*sq_a - a*b/3.0 + c) / 2.0;
+
+    double cb_p = p*p*p;
+    double discriminant = q*q + cb_p;
+    int count;
+
+    if (discriminant == 0.0) {
+        if (q == 0.0) {
+            roots[0] = 0.0;
+            count = 1;
+        } else {
+            double u = cbrt(-q);
+            roots[0] = 2.0*u;
+            roots[1] = -u;
+            count = 2;
+        }
+    } else if (discriminant < 0.0) {
+        double phi = acos(-q / sqrt(-cb_p)) / 3.0;
+        double t = 2.0*sqrt(-p);
+        roots[0] =  t*cos(phi);
+        roots[1] = -t*cos(phi + pi/3.0);
+        roots[2] = -t*cos(phi - pi/3.0);
+        count = 3;
+    } else {
+        double sqrt_d = sqrt(discriminant);
+        roots[0] = cbrt(sqrt_d - q) - cbrt(sqrt_d + q);
+        count = 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        roots[i] -= a/3.0;
+    }
+    return count;
+}
+
+/* x^4 + a*x^3 + b*x^2 + c*x + d = 0, by Ferrari's method through the resolvent cubic */
+inline int solve_quartic(double a, double b, double c, double d, double roots[4]) {
+    // substitute x = y - a/4 to get y^4 + p*y^2 + q*y + r = 0
+    double sq_a = a*a;
+    double p = -3.0/8.0*sq_a + b;
+    double q = sq_a*a/8.0 - a*b/2.0 + c;
+    double r = -3.0/256.0*sq_a*sq_a + sq_a*b/16.0 - a*c/4.0 + d;
+    int count;
+
+    if (fabs(r) < 1e-12) {
+        // y*(y^3 + p*y + q) = 0
+        count = solve_cubic(0.0, p, q, roots);
+        roots[count++] = 0.0;
+    } else {
+        // any real root z of the resolvent cubic factors the quartic into two quadratics
+        double cubic_roots[3];
+        solve_cubic(-p/2.0, -r, r*p/2.0 - q*q/8.0, cubic_roots);
+        double z = cubic_roots[0];
+
+        double u = z*z - r;
+        double v = 2.0*z - p;
+        if (u < 0.0 && u > -1e-12) u = 0.0;
+        if (v < 0.0 && v > -1e-12) v = 0.0;
+        if (u < 0.0 || v < 0.0) {
+            return 0;
+        }
+        u = sqrt(u);
+        v = sqrt(v);
+
+        count = solve_quadratic(q < 0.0 ? -v : v, z - u, roots);
+        count += solve_quadratic(q < 0.0 ? v : -v, z + u, roots + count);
+    }
+
+    for (int i = 0; i < count; i++) {
+        roots[i] -= a/4.0;
+    }
+    return count;
+}
+
+
 class torus : public hittable {
     public:
         torus() {}
@@ -20,68 +121,141 @@ class torus : public hittable {
             r2 = rad2;
             mat_ptr = m;
         }
-        
-        /* If given ray can hit the torus, marches the ray until ray-torus distance
-         * is less than dist_epsilon, and set the hit record. Returns true.
-         * If not, returns false.
-         */
-        bool ray_march(const ray& r, double t_min, double t_max, double t_epsilon, int depth, hit_record& rec) const;
 
         virtual bool hit(
             const ray& r, double t_min, double t_max, hit_record& rec) const override;
 
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+        virtual bool occluded(const ray& r, double t_min, double t_max) const override {
+            double t;
+            return intersect(r, t_min, t_max, t);
+        }
+
     public:
         point3 center;
         vec3 normal; // unitary
         double r1;
         double r2;
         shared_ptr<material> mat_ptr;
+
+    private:
+        /* finds the nearest t in [t_min, t_max] where r meets the surface */
+        bool intersect(const ray& r, double t_min, double t_max, double& t) const;
 };
 
-bool torus::ray_march(const ray& r, double t_min, double t_max, double t_epsilon, int depth, hit_record& rec) const {
-    // computes distance
-    double k = dot((r.origin()-center), normal);
-    point3 p = r.origin()-k*normal;
-    vec3 M = unit_vector(p - center);
-    point3 m = center + r1 * M;
-    double dist = (m - r.origin()).length() - r2;
-    double t = dist / r.direction().length();
-
-    // base case: depth==0 or t<=t_epsilon
-    if (depth==0 || t<=t_epsilon) {
-        if (depth==0 and t>t_epsilon) {
+
+bool torus::bounding_box(double time0, double time1, aabb& output_box) const {
+    // the center circle of radius r1 extends r1*sqrt(1 - n_i^2) along each axis i;
+    // the tube adds r2 in every direction
+    vec3 half_extent;
+    for (int a = 0; a < 3; a++) {
+        half_extent[a] = r1 * sqrt(fmax(0.0, 1.0 - normal[a]*normal[a])) + r2;
+    }
+    output_box = aabb(center - half_extent, center + half_extent);
+    return true;
+}
+
+
+bool torus::intersect(const ray& r, double t_min, double t_max, double& t) const {
+    // work in units of distance s along the normalized direction, relative to the center
+    double length = r.direction().length();
+    vec3 dir = r.direction() / length;
+    vec3 oc = r.origin() - center;
+    double s_min = t_min * length;
+    double s_max = t_max * length;
+
+    // reject rays that miss the bounding sphere of radius r1 + r2
+    double radius = r1 + r2;
+    double half_b = dot(oc, dir);
+    double c = oc.length_squared() - radius*radius;
+    double discriminant = half_b*half_b - c;
+    if (discriminant < 0.0) {
+        return false;
+    }
+    double sqrt_d = sqrt(discriminant);
+    s_min = fmax(s_min, -half_b - sqrt_d);
+    s_max = fmin(s_max, -half_b + sqrt_d);
+
+    // and the rays that miss the slab |dot(p, normal)| <= r2 inside it
+    double o_n = dot(oc, normal);
+    double d_n = dot(dir, normal);
+    if (d_n == 0.0) {
+        if (fabs(o_n) > r2) {
             return false;
         }
-        else {
-            if (t<t_min || t>t_max) {
-                return false;
-            }
-            else {
-                point3 pos_intersect = r.at(t);
-                rec.p = pos_intersect;
-                rec.t = t;
-                double k1 = dot((pos_intersect-center), normal);
-                point3 p1 = pos_intersect-k1*normal;
-                vec3 M1 = unit_vector(p1 - center);
-                point3 m1 = center + r1 * M1;
-                vec3 surf_normal = pos_intersect - m1;
-                rec.set_face_normal(r, surf_normal);
-                rec.mat_ptr = mat_ptr;
-                return true;
+    } else {
+        double s0 = (-r2 - o_n) / d_n;
+        double s1 = ( r2 - o_n) / d_n;
+        s_min = fmax(s_min, fmin(s0, s1));
+        s_max = fmin(s_max, fmax(s0, s1));
+    }
+    if (s_max < s_min) {
+        return false;
+    }
+
+    // solve from the start of the interval, where the quartic is well conditioned
+    double shift = s_min;
+    vec3 o = oc + shift*dir;
+    o_n = dot(o, normal);
+
+    // (|p|^2 + r1^2 - r2^2)^2 = 4 r1^2 (|p|^2 - dot(p, normal)^2) with p = o + s*dir
+    double sq_r1 = r1*r1;
+    double f = dot(o, dir);
+    double g = o.length_squared();
+    double h = g + sq_r1 - r2*r2;
+    double coeffs[4] = {
+        4.0*f,
+        4.0*f*f + 2.0*h - 4.0*sq_r1 + 4.0*sq_r1*d_n*d_n,
+        4.0*f*h - 8.0*sq_r1*f + 8.0*sq_r1*o_n*d_n,
+        h*h - 4.0*sq_r1*g + 4.0*sq_r1*o_n*o_n
+    };
+
+    double roots[4];
+    int count = solve_quartic(coeffs[0], coeffs[1], coeffs[2], coeffs[3], roots);
+
+    double closest = infinity;
+    for (int i = 0; i < count; i++) {
+        // polish each root with a couple of Newton steps
+        double s = roots[i];
+        for (int k = 0; k < 2; k++) {
+            double value = (((s + coeffs[0])*s + coeffs[1])*s + coeffs[2])*s + coeffs[3];
+            double slope = ((4.0*s + 3.0*coeffs[0])*s + 2.0*coeffs[1])*s + coeffs[2];
+            if (slope == 0.0) {
+                break;
             }
+            s -= value / slope;
+        }
+        if (s >= 0.0 && s + shift <= s_max && s < closest) {
+            closest = s;
         }
     }
-    // recursive case: depth>0 and dist>dist_epsilon
-    else {
-        ray ray_new(r.at(t), r.direction());
-        return torus::ray_march(ray_new, 1e-4, t_max, t_epsilon, depth-1, rec);
+    if (closest == infinity) {
+        return false;
     }
+
+    t = (closest + shift) / length;
+    return t >= t_min && t <= t_max;
 }
 
 
 bool torus::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
-    // recursive ray marching
-    return ray_march(r, 0.01, t_max, 0.02, 10, rec);
+    double t;
+    if (!intersect(r, t_min, t_max, t)) {
+        return false;
+    }
+
+    // the normal points away from the nearest point on the center circle
+    point3 pos_intersect = r.at(t);
+    vec3 local = pos_intersect - center;
+    vec3 radial = local - dot(local, normal)*normal;
+    point3 m = center + r1 * unit_vector(radial);
+
+    rec.t = t;
+    rec.p = pos_intersect;
+    rec.set_face_normal(r, unit_vector(pos_intersect - m));
+    rec.mat_ptr = mat_ptr.get();
+    return true;
 }
 
 
@@ -9,106 +9,187 @@
 #include "hittable.h"
 
 
+/* Moller-Trumbore ray/triangle intersection against the triangle with vertex a and edges
+ * e1 = b-a, e2 = c-a. On a hit in (t_min, t_max) sets t and the barycentric coordinates
+ * u, v of the hit point, which is a + u*e1 + v*e2.
+ */
+inline bool hit_triangle(
+    const ray& r, const point3& a, const vec3& e1, const vec3& e2,
+    double t_min, double t_max, double& t, double& u, double& v
+) {
+    vec3 pvec = cross(r.direction(), e2);
+    double det = dot(e1, pvec);
+    if (fabs(det) < 1e-12) {
+        // ray is parallel to the triangle's plane
+        return false;
+    }
+    double inv_det = 1.0 / det;
+
+    vec3 tvec = r.origin() - a;
+    u = dot(tvec, pvec) * inv_det;
+    if (u < 0.0 || u > 1.0) {
+        return false;
+    }
+
+    vec3 qvec = cross(tvec, e1);
+    v = dot(r.direction(), qvec) * inv_det;
+    if (v < 0.0 || u + v > 1.0) {
+        return false;
+    }
+
+    t = dot(e2, qvec) * inv_det;
+    return t >= t_min && t <= t_max;
+}
+
+/* watertight ray/triangle intersection (Woop, Benthin and Wald 2013): the edge tests are done
+ * in a ray-aligned frame, so a ray crossing a shared edge hits exactly one of the triangles
+ * meeting there. Sets the same t, u, v as hit_triangle.
+ */
+inline bool hit_triangle_watertight(
+    const ray& r, const point3& a, const point3& b, const point3& c,
+    double t_min, double t_max, double& t, double& u, double& v
+) {
+    vec3 dir = r.direction();
+
+    // the axis along which the ray direction is largest becomes z
+    int kz = 0;
+    if (fabs(dir[1]) > fabs(dir[kz])) kz = 1;
+    if (fabs(dir[2]) > fabs(dir[kz])) kz = 2;
+    int kx = (kz + 1) % 3;
+    int ky = (kx + 1) % 3;
+    if (dir[kz] < 0.0) {
+        // keep the winding of the triangle
+        int tmp = kx;
+        kx = ky;
+        ky = tmp;
+    }
+
+    // shear so the ray points along +z
+    double sx = dir[kx] / dir[kz];
+    double sy = dir[ky] / dir[kz];
+    double sz = 1.0 / dir[kz];
+
+    vec3 pa = a - r.origin();
+    vec3 pb = b - r.origin();
+    vec3 pc = c - r.origin();
+
+    double ax = pa[kx] - sx*pa[kz];
+    double ay = pa[ky] - sy*pa[kz];
+    double bx = pb[kx] - sx*pb[kz];
+    double by = pb[ky] - sy*pb[kz];
+    double cx = pc[kx] - sx*pc[kz];
+    double cy = pc[ky] - sy*pc[kz];
+
+    // scaled barycentric coordinates; a hit has them all of the same sign
+    double ea = cx*by - cy*bx;
+    double eb = ax*cy - ay*cx;
+    double ec = bx*ay - by*ax;
+    if ((ea < 0.0 || eb < 0.0 || ec < 0.0) && (ea > 0.0 || eb > 0.0 || ec > 0.0)) {
+        return false;
+    }
+
+    double det = ea + eb + ec;
+    if (det == 0.0) {
+        return false;
+    }
+
+    double inv_det = 1.0 / det;
+    t = (ea*sz*pa[kz] + eb*sz*pb[kz] + ec*sz*pc[kz]) * inv_det;
+    if (t < t_min || t > t_max) {
+        return false;
+    }
+
+    u = eb * inv_det;
+    v = ec * inv_det;
+    return true;
+}
+
+
+/* returns the bounding box of the triangle with vertices a, b, c
+ */
+inline aabb triangle_box(const point3& a, const point3& b, const point3& c) {
+    point3 small(fmin(a.x(), fmin(b.x(), c.x())),
+                 fmin(a.y(), fmin(b.y(), c.y())),
+                 fmin(a.z(), fmin(b.z(), c.z())));
+    point3 big(fmax(a.x(), fmax(b.x(), c.x())),
+               fmax(a.y(), fmax(b.y(), c.y())),
+               fmax(a.z(), fmax(b.z(), c.z())));
+
+    // The bounding box must have non-zero width in each dimension, so pad any dimension the
+    // triangle lies flat in a small amount.
+    for (int i = 0; i < 3; i++) {
+        if (big[i] - small[i] < 0.0001) {
+            small[i] -= 0.0001;
+            big[i] += 0.0001;
+        }
+    }
+
+    return aabb(small, big);
+}
+
+
 class triangle : public hittable {
     public:
         triangle() {}
 
-        triangle(point3 pt_a, point3 pt_b, point3 pt_c, shared_ptr<material> m)
-            : pt_a(pt_a), pt_b(pt_b), pt_c(pt_c), mat_ptr(m) {};
+        /* with watertight set, rays through an edge shared by two triangles are guaranteed to
+         * hit one of them; the default intersection is faster but may let such rays through
+         */
+        triangle(point3 pt_a, point3 pt_b, point3 pt_c, shared_ptr<material> m, bool watertight = false)
+            : pt_a(pt_a), pt_b(pt_b), pt_c(pt_c), mat_ptr(m), watertight(watertight) {
+            edge_ab = pt_b - pt_a;
+            edge_ac = pt_c - pt_a;
+            outward_normal = unit_vector(cross(edge_ab, edge_ac));
+        };
 
         virtual bool hit(
             const ray& r, double t_min, double t_max, hit_record& rec) const override;
 
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+        virtual bool occluded(const ray& r, double t_min, double t_max) const override;
+
     public:
         point3 pt_a;
         point3 pt_b;
         point3 pt_c;
         shared_ptr<material> mat_ptr;
-        bool hit_plane(
-            const ray& r, double t_min, double t_max, hit_record& rec) const;
-        bool solve_bar_coords(
-            const ray& r, hit_record& rec) const;
+        bool watertight;
+        // precomputed for intersection
+        vec3 edge_ab;
+        vec3 edge_ac;
+        vec3 outward_normal;
 };
 
-/* returns true if the given ray hits the plane on which the triangle lies;
- * sets the hit record
- * modified from my Matlab script for exams
- */
-bool triangle::hit_plane(const ray& r, double t_min, double t_max, hit_record& rec) const {
-    vec3 ray = unit_vector(r.direction());  // unitary ray vector
-    point3 pos_camera = r.origin();
-    vec3 perp = cross((pt_b - pt_a), (pt_c - pt_a));
-    vec3 outward_normal = unit_vector(perp);
-    point3 pos_p = pt_a;
-
-    // get a
-    vec3 w = pos_p - pos_camera;
-    double a = dot(w, outward_normal);
-    // get b
-    double b = dot(ray, outward_normal);
-    // get k
-    if (check_equal(b, 0.0, 0.01)) {
-        // ray is parallel to the plane
-        return false;
-    }
-    double k = a/b;
-    // convert k to t
-    double t = k/r.dir.length();
-    if (t<t_min || t>t_max) {
-        // t outside of boundary
+bool triangle::bounding_box(double time0, double time1, aabb& output_box) const {
+    output_box = triangle_box(pt_a, pt_b, pt_c);
+    return true;
+}
+
+bool triangle::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    double t, u, v;
+    bool if_hit = watertight
+        ? hit_triangle_watertight(r, pt_a, pt_b, pt_c, t_min, t_max, t, u, v)
+        : hit_triangle(r, pt_a, edge_ab, edge_ac, t_min, t_max, t, u, v);
+    if (!if_hit) {
         return false;
     }
-    point3 pos_intersect = pos_camera + k*ray;
 
     // set the hit record
     rec.t = t;
-    rec.p = pos_intersect;
+    rec.u = u;
+    rec.v = v;
+    rec.p = r.at(t);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mat_ptr;
+    rec.mat_ptr = mat_ptr.get();
     return true;
 }
 
-/* solves for the barycentric coordinates of the hit point;
- * returns false if the sum of the coordinates > 1.
- * modified from my Matlab script for exams
- */
-bool triangle::solve_bar_coords(const ray& r, hit_record& rec) const {
-    point3 pt_p = rec.p;
-    vec3 ab = pt_b-pt_a;
-    vec3 ac = pt_c-pt_a;
-    vec3 pb = pt_b-pt_p;
-    vec3 pa = pt_a-pt_p;
-    vec3 pc = pt_c-pt_p;
-    
-    double At = 0.5*cross(ab, ac).length();
-    double Aa = 0.5*cross(pb, pc).length();
-    double Ab = 0.5*cross(pa, pc).length();
-    double Ac = 0.5*cross(pa, pb).length();
-    
-    double alpha = Aa/At;
-    double beta = Ab/At;
-    double gamma = Ac/At;
-    if (!check_equal((alpha+beta+gamma), 1.0, 0.01)) {
-        // point is outside the triangle
-        return false;
-    }
-    else {
-        return true;
-    }
-}
-
-bool triangle::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
-    // compute where the ray hits on the triangle's plane
-    if (!hit_plane(r, t_min, t_max, rec)) {
-        return false;
-    }
-    
-    // check if the hit point is inside the triangle; returns false if not
-    if (!solve_bar_coords(r, rec)) {
-        return false;
-    }
-    
-    return true;
+bool triangle::occluded(const ray& r, double t_min, double t_max) const {
+    double t, u, v;
+    return watertight
+        ? hit_triangle_watertight(r, pt_a, pt_b, pt_c, t_min, t_max, t, u, v)
+        : hit_triangle(r, pt_a, edge_ab, edge_ac, t_min, t_max, t, u, v);
 }
 
 
@@ -0,0 +1,311 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "bvh.h"
+#include "hittable.h"
+#include "triangle.h"
+
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+
+struct mesh_bvh_node {
+    aabb box;
+    std::uint32_t offset;  // leaf: first triangle; interior: index of the second child
+    int count;             // number of triangles in a leaf; 0 for interior nodes
+    int axis;              // split axis of an interior node
+};
+
+
+class triangle_mesh : public hittable {
+    /* a triangle mesh sharing one vertex array and one material between all of its triangles;
+     * triangle k has the vertices indices[3k], indices[3k+1] and indices[3k+2]. The mesh keeps
+     * its own BVH over the triangles, flattened depth-first with the first child of a node
+     * directly after it
+     */
+    public:
+        triangle_mesh() {}
+
+        /* the vertices and indices are moved into the mesh, so callers with large meshes can
+         * std::move their arrays in instead of copying them
+         */
+        triangle_mesh(
+            std::vector<point3> vertices, std::vector<std::uint32_t> indices,
+            shared_ptr<material> m, bool watertight = false);
+
+        virtual bool hit(
+            const ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+        virtual bool occluded(const ray& r, double t_min, double t_max) const override;
+
+        size_t triangle_count() const { return indices.size() / 3; }
+
+    public:
+        std::vector<point3> vertices;
+        std::vector<std::uint32_t> indices;  // reordered so each BVH leaf is a contiguous run
+        shared_ptr<material> mat_ptr;
+        bool watertight;
+        std::vector<mesh_bvh_node> nodes;
+
+    private:
+        static const int max_leaf_size = 4;
+        static const int max_depth = 64;
+
+        std::uint32_t build(std::vector<bvh_primitive>& prims, size_t start, size_t end, int depth);
+
+        void reorder_triangles(std::vector<bvh_primitive>& prims);
+
+        bool hit_triangle_at(
+            size_t k, const ray& r, double t_min, double t_max, double& t, double& u, double& v
+        ) const {
+            const point3& a = vertices[indices[3*k]];
+            const point3& b = vertices[indices[3*k+1]];
+            const point3& c = vertices[indices[3*k+2]];
+            return watertight ? hit_triangle_watertight(r, a, b, c, t_min, t_max, t, u, v)
+                              : hit_triangle(r, a, b-a, c-a, t_min, t_max, t, u, v);
+        }
+};
+
+
+triangle_mesh::triangle_mesh(
+    std::vector<point3> vertices, std::vector<std::uint32_t> indices,
+    shared_ptr<material> m, bool watertight
+) : vertices(std::move(vertices)), indices(std::move(indices)), mat_ptr(m),
+    watertight(watertight)
+{
+    const auto& points = this->vertices;
+
+    if (this->indices.size() % 3 != 0) {
+        std::cerr << "ERROR: Triangle mesh index count " << this->indices.size()
+                  << " is not a multiple of 3.\n";
+        this->indices.clear();
+        return;
+    }
+    for (auto index : this->indices) {
+        if (index >= points.size()) {
+            std::cerr << "ERROR: Triangle mesh index " << index << " is out of range.\n";
+            this->indices.clear();
+            return;
+        }
+    }
+    if (this->indices.empty()) {
+        return;
+    }
+    if (triangle_count() > UINT32_MAX) {
+        std::cerr << "ERROR: Triangle mesh has more than " << UINT32_MAX << " triangles.\n";
+        this->indices.clear();
+        return;
+    }
+
+    std::vector<bvh_primitive> prims(triangle_count());
+    for (size_t k = 0; k < prims.size(); k++) {
+        prims[k].index = k;
+        prims[k].box = triangle_box(
+            points[this->indices[3*k]], points[this->indices[3*k+1]], points[this->indices[3*k+2]]);
+        prims[k].centroid = 0.5 * (prims[k].box.min() + prims[k].box.max());
+    }
+
+    nodes.reserve(2 * prims.size() / max_leaf_size + 1);
+    build(prims, 0, prims.size(), 0);
+    reorder_triangles(prims);
+}
+
+
+std::uint32_t triangle_mesh::build(
+    std::vector<bvh_primitive>& prims, size_t start, size_t end, int depth
+) {
+    auto index = static_cast<std::uint32_t>(nodes.size());
+    nodes.push_back(mesh_bvh_node());
+
+    aabb box = empty_box();
+    for (size_t i = start; i < end; i++) {
+        box = surrounding_box(box, prims[i].box);
+    }
+    nodes[index].box = box;
+
+    if (end - start <= max_leaf_size) {
+        // leaves are made in order, so once the triangles are reordered to match prims, this
+        // leaf's triangles are the run starting at start
+        nodes[index].offset = static_cast<std::uint32_t>(start);
+        nodes[index].count = static_cast<int>(end - start);
+        return index;
+    }
+
+    aabb centroid_bounds = empty_box();
+    for (size_t i = start; i < end; i++) {
+        centroid_bounds = surrounding_box(
+            centroid_bounds, aabb(prims[i].centroid, prims[i].centroid));
+    }
+    int axis = centroid_bounds.longest_axis();
+
+    // past half the traversal stack depth, fall back to median splits so the remaining levels
+    // are guaranteed to be balanced
+    auto mid = (depth < max_depth/2) ? bvh_split_sah(prims, start, end)
+                                     : bvh_split_median(prims, start, end, axis, true);
+
+    build(prims, start, mid, depth+1);
+    auto second = build(prims, mid, end, depth+1);
+
+    nodes[index].offset = second;
+    nodes[index].count = 0;
+    nodes[index].axis = axis;
+    return index;
+}
+
+
+void triangle_mesh::reorder_triangles(std::vector<bvh_primitive>& prims) {
+    // moves triangle prims[k].index to position k, following each cycle of the permutation
+    // so the indices are reordered in place rather than into a second copy of the array
+    for (size_t k = 0; k < prims.size(); k++) {
+        if (prims[k].index == k) {
+            continue;
+        }
+        std::uint32_t first[3] = { indices[3*k], indices[3*k+1], indices[3*k+2] };
+        size_t to = k;
+        while (true) {
+            size_t from = prims[to].index;
+            prims[to].index = to;
+            if (from == k) {
+                for (int corner = 0; corner < 3; corner++) {
+                    indices[3*to + corner] = first[corner];
+                }
+                break;
+            }
+            for (int corner = 0; corner < 3; corner++) {
+                indices[3*to + corner] = indices[3*from + corner];
+            }
+            to = from;
+        }
+    }
+}
+
+
+bool triangle_mesh::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    std::uint32_t stack[max_depth];
+    int stack_size = 0;
+    std::uint32_t current = 0;
+
+    // only the closest triangle needs a normal and a hit record
+    bool found = false;
+    size_t closest_triangle = 0;
+    double closest_t = t_max;
+    double closest_u = 0.0;
+    double closest_v = 0.0;
+
+    while (true) {
+        const auto& node = nodes[current];
+
+        if (node.box.hit(r, t_min, closest_t)) {
+            if (node.count > 0) {
+                for (size_t k = node.offset; k < node.offset + node.count; k++) {
+                    double t, u, v;
+                    if (hit_triangle_at(k, r, t_min, closest_t, t, u, v)) {
+                        found = true;
+                        closest_triangle = k;
+                        closest_t = t;
+                        closest_u = u;
+                        closest_v = v;
+                    }
+                }
+            } else {
+                // visit the child on the near side of the split first
+                if (r.sign(node.axis)) {
+                    stack[stack_size++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+
+        if (stack_size == 0) {
+            break;
+        }
+        current = stack[--stack_size];
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    const point3& a = vertices[indices[3*closest_triangle]];
+    const point3& b = vertices[indices[3*closest_triangle+1]];
+    const point3& c = vertices[indices[3*closest_triangle+2]];
+
+    rec.t = closest_t;
+    rec.u = closest_u;
+    rec.v = closest_v;
+    rec.p = r.at(closest_t);
+    rec.set_face_normal(r, unit_vector(cross(b - a, c - a)));
+    rec.mat_ptr = mat_ptr.get();
+    return true;
+}
+
+
+bool triangle_mesh::occluded(const ray& r, double t_min, double t_max) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    std::uint32_t stack[max_depth];
+    int stack_size = 0;
+    std::uint32_t current = 0;
+
+    // any triangle in range blocks the ray, so the first one found ends the traversal
+    while (true) {
+        const auto& node = nodes[current];
+
+        if (node.box.hit(r, t_min, t_max)) {
+            if (node.count > 0) {
+                for (size_t k = node.offset; k < node.offset + node.count; k++) {
+                    double t, u, v;
+                    if (hit_triangle_at(k, r, t_min, t_max, t, u, v)) {
+                        return true;
+                    }
+                }
+            } else {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+                continue;
+            }
+        }
+
+        if (stack_size == 0) {
+            return false;
+        }
+        current = stack[--stack_size];
+    }
+}
+
+
+bool triangle_mesh::bounding_box(double time0, double time1, aabb& output_box) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    output_box = nodes[0].box;
+    return true;
+}
+
+
+#endif
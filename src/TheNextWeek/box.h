@@ -29,6 +29,12 @@ class box : public hittable  {
             return true;
         }
 
+        virtual int hit_packet(
+            const ray_packet& packet, int mask, double t_min, double t_max[], hit_record recs[]
+        ) const override {
+            return sides.hit_packet(packet, mask, t_min, t_max, recs);
+        }
+
     public:
         point3 box_min;
         point3 box_max;
@@ -14,6 +14,7 @@
 #include "rtweekend.h"
 
 #include "aabb.h"
+#include "ray_packet.h"
 
 
 class material;
@@ -22,7 +23,7 @@ class material;
 struct hit_record {
     point3 p;
     vec3 normal;
-    shared_ptr<material> mat_ptr;
+    material* mat_ptr;  // Not owned; the object that was hit keeps its material alive
     double t;
     double u;
     double v;
@@ -39,6 +40,25 @@ class hittable {
     public:
         virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
         virtual bool bounding_box(double time0, double time1, aabb& output_box) const = 0;
+
+        // Intersects the rays of a packet selected by mask. Each ray i that hits something
+        // closer than t_max[i] gets its record in recs[i], has t_max[i] lowered to the hit and
+        // sets bit i of the returned mask; other records are left alone. By default the rays
+        // are traced one at a time.
+        virtual int hit_packet(
+            const ray_packet& packet, int mask, double t_min, double t_max[], hit_record recs[]
+        ) const {
+            int hits = 0;
+            hit_record temp_rec;
+            for (int i = 0; i < packet.size; i++) {
+                if (((mask >> i) & 1) && hit(packet.rays[i], t_min, t_max[i], temp_rec)) {
+                    recs[i] = temp_rec;
+                    t_max[i] = temp_rec.t;
+                    hits |= 1 << i;
+                }
+            }
+            return hits;
+        }
 };
 
 class translate : public hittable {
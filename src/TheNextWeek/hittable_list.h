@@ -32,6 +32,10 @@ class hittable_list : public hittable  {
 
         virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
 
+        virtual int hit_packet(
+            const ray_packet& packet, int mask, double t_min, double t_max[], hit_record recs[]
+        ) const override;
+
     public:
         std::vector<shared_ptr<hittable>> objects;
 };
@@ -54,6 +58,17 @@ bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& re
 }
 
 
+int hittable_list::hit_packet(
+    const ray_packet& packet, int mask, double t_min, double t_max[], hit_record recs[]
+) const {
+    // Each object lowers t_max for the rays it hits, so later objects only report closer hits.
+    int hits = 0;
+    for (const auto& object : objects)
+        hits |= object->hit_packet(packet, mask, t_min, t_max, recs);
+    return hits;
+}
+
+
 bool hittable_list::bounding_box(double time0, double time1, aabb& output_box) const {
     if (objects.empty()) return false;
 
@@ -0,0 +1,351 @@
+#ifndef LINEAR_BVH_H
+#define LINEAR_BVH_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "bvh.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+
+struct linear_bvh_node {
+    // Node bounds are stored in single precision, rounded outwards so that they always contain
+    // the double precision boxes they were built from.
+    float box_min[3];
+    float box_max[3];
+    std::uint32_t offset;  // Leaf: index of its leaf group. Interior: index of the second child.
+    std::uint16_t count;   // Number of primitives in a leaf; 0 for interior nodes.
+    std::uint8_t axis;     // Split axis of an interior node.
+    std::uint8_t pad;
+};
+
+static_assert(sizeof(linear_bvh_node) == 32, "linear_bvh_node should be 32 bytes");
+
+
+struct linear_bvh_leaf {
+    // A leaf's primitives are primitives[first] to primitives[first + count - 1], with count
+    // taken from its node, and their boxes are the lanes of boxes.
+    aabb4 boxes;
+    std::uint32_t first;
+};
+
+
+class linear_bvh : public hittable {
+    // A BVH flattened into a depth-first array: the first child of an interior node directly
+    // follows it, and the node records the index of the second. Traversal is iterative and
+    // makes no virtual calls or shared_ptr copies until it reaches a leaf. Each leaf holds up
+    // to four primitives, and their boxes are tested together so only the primitives the ray
+    // can reach are called.
+    public:
+        linear_bvh() {}
+        linear_bvh(const hittable_list& list, double time0, double time1);
+
+        virtual bool hit(
+            const ray& r, double t_min, double t_max, hit_record& rec) const override;
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+        virtual int hit_packet(
+            const ray_packet& packet, int mask, double t_min, double t_max[], hit_record recs[]
+        ) const override;
+
+    public:
+        std::vector<linear_bvh_node> nodes;
+        std::vector<linear_bvh_leaf> leaves;
+        std::vector<shared_ptr<hittable>> primitives;  // In leaf order, with no gaps
+
+    private:
+        static const int max_leaf_size = 4;
+        static const int max_depth = 64;
+        static const int min_packet_lanes = 3;  // Fewer rays than this go on alone
+
+        bool hit_subtree(
+            int root, const ray& r, double t_min, double t_max, hit_record& rec) const;
+
+        int build(
+            const hittable_list& list, std::vector<bvh_primitive>& prims,
+            size_t start, size_t end, int depth);
+
+        static bool hit_node(const linear_bvh_node& node, const ray& r, double t_min, double t_max) {
+            // Branchless slab test, as in aabb::hit.
+            for (int a = 0; a < 3; a++) {
+                double lo = node.box_min[a], hi = node.box_max[a];
+                auto t0 = ((r.sign(a) ? hi : lo) - r.orig[a]) * r.inv_dir[a];
+                auto t1 = ((r.sign(a) ? lo : hi) - r.orig[a]) * r.inv_dir[a];
+                t_min = t0 > t_min ? t0 : t_min;
+                t_max = t1 < t_max ? t1 : t_max;
+            }
+            return t_min < t_max;
+        }
+};
+
+
+linear_bvh::linear_bvh(const hittable_list& list, double time0, double time1) {
+    if (list.objects.empty())
+        return;
+
+    auto prims = bvh_primitives(list.objects, 0, list.objects.size(), time0, time1);
+
+    nodes.reserve(2 * prims.size());
+    build(list, prims, 0, prims.size(), 0);
+}
+
+
+int linear_bvh::build(
+    const hittable_list& list, std::vector<bvh_primitive>& prims,
+    size_t start, size_t end, int depth
+) {
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back(linear_bvh_node());
+
+    aabb box = empty_box();
+    for (size_t i = start; i < end; i++)
+        box = surrounding_box(box, prims[i].box);
+
+    for (int a = 0; a < 3; a++) {
+        auto lo = static_cast<float>(box.min()[a]);
+        auto hi = static_cast<float>(box.max()[a]);
+        nodes[index].box_min[a] = std::nextafter(lo, -std::numeric_limits<float>::infinity());
+        nodes[index].box_max[a] = std::nextafter(hi,  std::numeric_limits<float>::infinity());
+    }
+
+    if (end - start <= max_leaf_size) {
+        nodes[index].offset = static_cast<std::uint32_t>(leaves.size());
+        nodes[index].count = static_cast<std::uint16_t>(end - start);
+        linear_bvh_leaf leaf;
+        leaf.first = static_cast<std::uint32_t>(primitives.size());
+        for (size_t i = start; i < end; i++) {
+            leaf.boxes.set(static_cast<int>(i - start), prims[i].box);
+            primitives.push_back(list.objects[prims[i].index]);
+        }
+        leaves.push_back(leaf);
+        return index;
+    }
+
+    aabb centroid_bounds = empty_box();
+    for (size_t i = start; i < end; i++)
+        centroid_bounds = surrounding_box(
+            centroid_bounds, aabb(prims[i].centroid, prims[i].centroid));
+    int axis = centroid_bounds.longest_axis();
+
+    // Past half the traversal stack depth, fall back to median splits so the remaining levels
+    // are guaranteed to be balanced.
+    auto mid = (depth < max_depth/2) ? bvh_split_sah(prims, start, end)
+                                     : bvh_split_median(prims, start, end, axis, true);
+
+    build(list, prims, start, mid, depth+1);
+    auto second = build(list, prims, mid, end, depth+1);
+
+    nodes[index].offset = static_cast<std::uint32_t>(second);
+    nodes[index].count = 0;
+    nodes[index].axis = static_cast<std::uint8_t>(axis);
+    return index;
+}
+
+
+bool linear_bvh::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+    if (nodes.empty())
+        return false;
+
+    return hit_subtree(0, r, t_min, t_max, rec);
+}
+
+
+bool linear_bvh::hit_subtree(
+    int root, const ray& r, double t_min, double t_max, hit_record& rec
+) const {
+    int stack[max_depth];
+    int stack_size = 0;
+    int current = root;
+
+    bool hit_anything = false;
+    auto closest_so_far = t_max;
+
+    while (true) {
+        const auto& node = nodes[current];
+
+        if (hit_node(node, r, t_min, closest_so_far)) {
+            if (node.count > 0) {
+                const auto& leaf = leaves[node.offset];
+                auto mask = leaf.boxes.hit(r, t_min, closest_so_far);
+                for (int i = 0; i < node.count; i++) {
+                    if (((mask >> i) & 1)
+                        && primitives[leaf.first + i]->hit(r, t_min, closest_so_far, rec)
+                    ) {
+                        hit_anything = true;
+                        closest_so_far = rec.t;
+                    }
+                }
+            } else {
+                // Descend into the child on the near side of the split first; a hit there
+                // shrinks closest_so_far and lets the far child be culled.
+                if (r.sign(node.axis)) {
+                    stack[stack_size++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+
+        if (stack_size == 0)
+            break;
+        current = stack[--stack_size];
+    }
+
+    return hit_anything;
+}
+
+
+int linear_bvh::hit_packet(
+    const ray_packet& packet, int mask, double t_min, double t_max[], hit_record recs[]
+) const {
+    if (nodes.empty() || mask == 0)
+        return 0;
+
+    // Rays pointing different ways want different child orders; trace those one at a time.
+    if (!packet.coherent(mask))
+        return hittable::hit_packet(packet, mask, t_min, t_max, recs);
+
+    int lead = 0;
+    while (!((mask >> lead) & 1))
+        lead++;
+    const ray& lead_ray = packet.rays[lead];
+
+    // Lay the rays out axis by axis, so the slab test below runs over all rays in one loop
+    // per axis. With the signs shared, each axis has one near and one far plane for them all.
+    // The loops always cover max_size lanes, a fixed count the compiler can vectorize; lanes
+    // past the packet's size are zeroed and masked off.
+    const int n = packet.size;
+    const int lanes = ray_packet::max_size;
+    double origin[3][lanes] = {};
+    double inv_dir[3][lanes] = {};
+    for (int a = 0; a < 3; a++) {
+        for (int i = 0; i < n; i++) {
+            origin[a][i] = packet.rays[i].orig[a];
+            inv_dir[a][i] = packet.rays[i].inv_dir[a];
+        }
+    }
+    double far_limit[lanes];
+
+    // Each stack entry remembers which rays reached the parent, so a subtree is only tested
+    // against the rays that can enter it.
+    int stack[max_depth];
+    int stack_mask[max_depth];
+    int stack_size = 0;
+    int current = 0;
+    int active = mask;
+    int hits = 0;
+
+    while (true) {
+        const auto& node = nodes[current];
+
+        for (int i = 0; i < lanes; i++)
+            far_limit[i] = (i < n) ? t_max[i] : t_min;
+
+        double near[lanes];
+        double far[lanes];
+        for (int i = 0; i < lanes; i++) {
+            near[i] = t_min;
+            far[i] = far_limit[i];
+        }
+        for (int a = 0; a < 3; a++) {
+            double lo = lead_ray.sign(a) ? node.box_max[a] : node.box_min[a];
+            double hi = lead_ray.sign(a) ? node.box_min[a] : node.box_max[a];
+            for (int i = 0; i < lanes; i++) {
+                auto t0 = (lo - origin[a][i]) * inv_dir[a][i];
+                auto t1 = (hi - origin[a][i]) * inv_dir[a][i];
+                near[i] = t0 > near[i] ? t0 : near[i];
+                far[i]  = t1 < far[i]  ? t1 : far[i];
+            }
+        }
+        int node_mask = 0;
+        for (int i = 0; i < lanes; i++)
+            node_mask |= (near[i] < far[i]) << i;
+        node_mask &= active;
+
+        if (node_mask != 0 && lane_count(node_mask) < min_packet_lanes) {
+            // Too few rays are left to share the work of a node, so each finishes this subtree
+            // with the single ray traversal.
+            for (int i = 0; i < n; i++) {
+                if (((node_mask >> i) & 1)
+                    && hit_subtree(current, packet.rays[i], t_min, t_max[i], recs[i])
+                ) {
+                    t_max[i] = recs[i].t;
+                    hits |= 1 << i;
+                }
+            }
+        } else if (node_mask != 0) {
+            if (node.count > 0) {
+                // Sort the rays by which of the leaf's primitive boxes they hit, then give
+                // each primitive all of its rays at once.
+                const auto& leaf = leaves[node.offset];
+                int primitive_mask[4] = { 0, 0, 0, 0 };
+                for (int i = 0; i < packet.size; i++) {
+                    if (!((node_mask >> i) & 1))
+                        continue;
+                    auto boxes_hit = leaf.boxes.hit(packet.rays[i], t_min, t_max[i]);
+                    for (int p = 0; p < node.count; p++) {
+                        if ((boxes_hit >> p) & 1)
+                            primitive_mask[p] |= 1 << i;
+                    }
+                }
+                for (int p = 0; p < node.count; p++) {
+                    if (primitive_mask[p] != 0)
+                        hits |= primitives[leaf.first + p]->hit_packet(
+                            packet, primitive_mask[p], t_min, t_max, recs);
+                }
+            } else {
+                // The rays share their direction signs, so the lead ray's near child is near
+                // for all of them.
+                if (lead_ray.sign(node.axis)) {
+                    stack[stack_size] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stack_size] = node.offset;
+                    current = current + 1;
+                }
+                stack_mask[stack_size++] = node_mask;
+                active = node_mask;
+                continue;
+            }
+        }
+
+        if (stack_size == 0)
+            break;
+        --stack_size;
+        current = stack[stack_size];
+        active = stack_mask[stack_size];
+    }
+
+    return hits;
+}
+
+
+bool linear_bvh::bounding_box(double time0, double time1, aabb& output_box) const {
+    if (nodes.empty())
+        return false;
+
+    const auto& root = nodes[0];
+    output_box = aabb(point3(root.box_min[0], root.box_min[1], root.box_min[2]),
+                      point3(root.box_max[0], root.box_max[1], root.box_max[2]));
+    return true;
+}
+
+
+#endif
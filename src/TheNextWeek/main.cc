@@ -14,36 +14,73 @@
 #include "box.h"
 #include "bvh.h"
 #include "camera.h"
+#include "checkpoint.h"
 #include "color.h"
 #include "constant_medium.h"
+#include "framebuffer.h"
 #include "hittable_list.h"
+#include "image_output.h"
+#include "linear_bvh.h"
 #include "material.h"
 #include "moving_sphere.h"
+#include "sample_stats.h"
 #include "sphere.h"
 #include "texture.h"
-
+#include "tile_renderer.h"
+#include "wavefront.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 
-color ray_color(const ray& r, const color& background, const hittable& world, int depth) {
-    hit_record rec;
-
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-        return color(0,0,0);
-
-    // If the ray hits nothing, return the background color.
-    if (!world.hit(r, 0.001, infinity, rec))
-        return background;
-
-    ray scattered;
-    color attenuation;
-    color emitted = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+color ray_color(
+    const ray& r, bool hit_first, const hit_record& first_rec, const color& background,
+    const hittable& world, int max_depth, int rr_depth
+) {
+    // Follows the path iteratively, carrying the product of the attenuations so far as its
+    // throughput. After rr_depth bounces, Russian roulette ends each path with a probability
+    // that grows as its throughput falls, and scales up the survivors to keep the estimate
+    // unbiased. The first intersection has already been found by the caller: hit_first tells
+    // whether r hit anything, and first_rec holds the hit.
+    color radiance(0,0,0);
+    color throughput(1,1,1);
+    ray current = r;
+    hit_record rec = first_rec;
+    bool hit = hit_first;
+
+    for (int depth = 0; depth < max_depth; depth++) {
+        if (depth > 0)
+            hit = world.hit(current, 0.001, infinity, rec);
+
+        // If the ray hits nothing, return the background color.
+        if (!hit)
+            return radiance + throughput * background;
+
+        ray scattered;
+        color attenuation;
+        radiance += throughput * rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+
+        if (!rec.mat_ptr->scatter(current, rec, attenuation, scattered))
+            return radiance;
+
+        throughput = throughput * attenuation;
+
+        if (depth + 1 >= rr_depth) {
+            auto survival = fmin(fmax(throughput.x(), fmax(throughput.y(), throughput.z())), 0.95);
+            if (random_double() >= survival)
+                return radiance;
+            throughput /= survival;
+        }
 
-    if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-        return emitted;
+        current = scattered;
+    }
 
-    return emitted + attenuation * ray_color(scattered, background, world, depth-1);
+    // If we've exceeded the ray bounce limit, no more light is gathered.
+    return radiance;
 }
 
 
@@ -203,7 +240,7 @@ hittable_list cornell_smoke() {
 }
 
 
-hittable_list final_scene() {
+hittable_list final_scene(bool report_bvh) {
     hittable_list boxes1;
     auto ground = make_shared<lambertian>(color(0.48, 0.83, 0.53));
 
@@ -224,7 +261,7 @@ hittable_list final_scene() {
 
     hittable_list objects;
 
-    objects.add(make_shared<bvh_node>(boxes1, 0, 1));
+    objects.add(make_shared<linear_bvh>(boxes1, 0, 1));
 
     auto light = make_shared<diffuse_light>(color(7, 7, 7));
     objects.add(make_shared<xz_rect>(123, 423, 147, 412, 554, light));
@@ -257,9 +294,15 @@ hittable_list final_scene() {
         boxes2.add(make_shared<sphere>(point3::random(0,165), 10, white));
     }
 
+    // Compare the BVH split methods on this scene's object groups.
+    if (report_bvh) {
+        bvh_report(std::cerr, "Ground boxes", boxes1, 0, 1);
+        bvh_report(std::cerr, "Sphere cluster", boxes2, 0, 1);
+    }
+
     objects.add(make_shared<translate>(
         make_shared<rotate_y>(
-            make_shared<bvh_node>(boxes2, 0.0, 1.0), 15),
+            make_shared<linear_bvh>(boxes2, 0.0, 1.0), 15),
             vec3(-100,270,395)
         )
     );
@@ -268,14 +311,56 @@ hittable_list final_scene() {
 }
 
 
-int main() {
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int) {
+    // Asks the render to stop at the end of the current pass.
+    stop_requested = 1;
+}
+
+
+int main(int argc, char* argv[]) {
+
+    // Command line: an optional output file name, --packets to find the first hits of
+    // neighboring camera rays together, --wavefront to trace breadth first,
+    // --bvh-report to compare the BVH split methods on the final scene's object groups,
+    // --heatmap <file> to also write a map of the samples each pixel took, --checkpoint <file>
+    // to save the render to, and resume it from, and --seed <n> to pick
+    // the random numbers of this run.
+
+    const char* output_file = nullptr;
+    const char* heatmap_file = nullptr;
+    const char* checkpoint_file = nullptr;
+    std::uint64_t render_seed = 0;
+    bool use_packets = false;
+    bool use_wavefront = false;
+    bool report_bvh = false;
+    for (int arg = 1; arg < argc; ++arg) {
+        if (std::strcmp(argv[arg], "--packets") == 0)
+            use_packets = true;
+        else if (std::strcmp(argv[arg], "--wavefront") == 0)
+            use_wavefront = true;
+        else if (std::strcmp(argv[arg], "--bvh-report") == 0)
+            report_bvh = true;
+        else if (std::strcmp(argv[arg], "--heatmap") == 0 && arg+1 < argc)
+            heatmap_file = argv[++arg];
+        else if (std::strcmp(argv[arg], "--checkpoint") == 0 && arg+1 < argc)
+            checkpoint_file = argv[++arg];
+        else if (std::strcmp(argv[arg], "--seed") == 0 && arg+1 < argc)
+            render_seed = std::strtoull(argv[++arg], nullptr, 10);
+        else
+            output_file = argv[arg];
+    }
 
     // Image
 
     auto aspect_ratio = 16.0 / 9.0;
     int image_width = 400;
-    int samples_per_pixel = 100;
+    int samples_per_pixel = 100;  // The most any pixel takes
+    int min_samples = 32;         // The fewest any pixel takes
+    double max_error = 0.01;      // Relative error at which a pixel stops; zero to never stop
     int max_depth = 50;
+    int rr_depth = 3;  // Bounces before Russian roulette may end a path
 
     // World
 
@@ -351,7 +436,7 @@ int main() {
             break;
 
         case 8:
-            world = final_scene();
+            world = final_scene(report_bvh);
             aspect_ratio = 1.0;
             image_width = 800;
             samples_per_pixel = 10000;
@@ -371,21 +456,225 @@ int main() {
 
     // Render
 
-    std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-
-    for (int j = image_height-1; j >= 0; --j) {
-        std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
-        for (int i = 0; i < image_width; ++i) {
-            color pixel_color(0,0,0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = (i + random_double()) / (image_width-1);
-                auto v = (j + random_double()) / (image_height-1);
-                ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, background, world, max_depth);
+    const double snapshot_seconds = 60;  // Time between writes of the image and checkpoint
+
+    adaptive_sampling sampling;
+    sampling.min_samples = std::min(min_samples, samples_per_pixel);
+    sampling.max_samples = samples_per_pixel;
+    sampling.max_error = max_error;
+    sampling.min_luminance = 0.01;
+
+    framebuffer image(image_width, image_height);
+    image.count_samples();
+    frame_stats stats(image_width, image_height);
+
+    // Resume from the checkpoint if there is one of this render. A checkpoint from another
+    // seed, or a merge of several runs, would mix up the streams of random numbers. One taken
+    // with other rules for stopping would leave the wrong pixels retired, except that a raised
+    // sample cap just gives every pixel another chance to take more samples.
+    if (checkpoint_file) {
+        render_checkpoint checkpoint;
+        if (checkpoint.read(checkpoint_file)) {
+            if (checkpoint.width != image_width || checkpoint.height != image_height
+                || checkpoint.seed != render_seed || checkpoint.runs != 1) {
+                std::cerr << "ERROR: Checkpoint '" << checkpoint_file
+                          << "' is of a different render.\n";
+                return 1;
+            }
+
+            const auto& saved = checkpoint.sampling;
+            if (saved.max_samples > sampling.max_samples
+                || saved.min_samples != std::min(min_samples, saved.max_samples)
+                || saved.max_error != sampling.max_error
+                || saved.min_luminance != sampling.min_luminance) {
+                std::cerr << "ERROR: Checkpoint '" << checkpoint_file
+                          << "' was rendered with different sampling settings.\n";
+                return 1;
+            }
+
+            checkpoint.restore(image, stats);
+            std::cerr << "Resuming from checkpoint '" << checkpoint_file << "'.\n";
+
+            if (saved.max_samples < sampling.max_samples) {
+                std::fill(stats.active.begin(), stats.active.end(), 1);
+                std::cerr << "Raising the sample cap from " << saved.max_samples << " to "
+                          << sampling.max_samples << ".\n";
             }
-            write_color(std::cout, pixel_color, samples_per_pixel);
         }
     }
 
+    tile_renderer renderer(image_width, image_height);
+    renderer.show_progress = false;
+    shared_ptr<wavefront_renderer> wavefront;
+    if (use_wavefront)
+        wavefront = make_shared<wavefront_renderer>(cam, world, background, image_width,
+            image_height, samples_per_pixel, max_depth, rr_depth, render_seed);
+
+    // Writes the image as it stands to the file named on the command line, in the format given
+    // by its extension, along with the heatmap and checkpoint if asked for. Without a file
+    // name, the image goes to standard output as binary PPM, but only once it is finished.
+    auto write_output = [&](bool finished) {
+        bool ok = true;
+        if (output_file)
+            ok = write_image(output_file, image, samples_per_pixel) && ok;
+        else if (finished)
+            ok = write_ppm(image, samples_per_pixel) && ok;
+        if (heatmap_file) {
+            auto heatmap = sample_heatmap(image, samples_per_pixel, samples_per_pixel);
+            ok = write_image(heatmap_file, heatmap, 1) && ok;
+        }
+        if (checkpoint_file)
+            ok = render_checkpoint(image, stats, sampling, render_seed).write(checkpoint_file)
+                 && ok;
+        return ok;
+    };
+
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+
+    // Takes one more sample for pixel (i,j) if it is still active and below samples_per_pixel,
+    // and returns false if it is not. Each sample of each pixel draws from its own generator,
+    // so the image is independent of the thread count, the pass sizes, and where a render was
+    // resumed.
+    auto sample_pixel = [&](int i, int j) {
+        auto& pixel = stats.at(i,j);
+        if (!stats.is_active(i,j) || pixel.count >= samples_per_pixel)
+            return false;
+
+        const auto pixel_index = static_cast<std::uint64_t>(j)*image_width + i;
+        thread_rng().seed_stream(render_seed, sample_stream(pixel_index, pixel.count));
+        auto u = (i + random_double()) / (image_width-1);
+        auto v = (j + random_double()) / (image_height-1);
+        ray r = cam.get_ray(u, v);
+
+        hit_record rec;
+        bool hit = world.hit(r, 0.001, infinity, rec);
+        auto sample_color = ray_color(r, hit, rec, background, world, max_depth, rr_depth);
+
+        pixel.add(sample_color, hit);
+        image.at(i,j) += sample_color;
+        image.count_at(i,j) = pixel.count;
+        return true;
+    };
+
+    // With --packets, takes one more sample for each pixel of the run of count pixels starting
+    // at (i0,j) that is still active and below samples_per_pixel, and returns false if there
+    // were none. The camera rays of a run of neighboring pixels take similar paths through the
+    // scene, so their first intersections are found together as a packet. The rest of each
+    // path diverges and is traced one ray at a time.
+    const auto image_pixels = static_cast<std::uint64_t>(image_height)*image_width;
+
+    auto sample_run = [&](int i0, int j, int count) {
+        const auto first_pixel = static_cast<std::uint64_t>(j)*image_width + i0;
+
+        // Pixels that are done are left out of the mask, and the packet traversal skips them.
+        int active = 0;
+        for (int k = 0; k < count; ++k) {
+            if (stats.is_active(i0 + k, j) && stats.at(i0 + k, j).count < samples_per_pixel)
+                active |= 1 << k;
+        }
+        if (!active)
+            return false;
+
+        // The camera rays draw from the same generators as in sample_pixel. Intersections that
+        // draw random numbers, such as in media, use a generator of the packet's own, on a
+        // stream numbered past the pixels'.
+        ray_packet packet;
+        packet.size = count;
+        rng lane_rng[ray_packet::max_size];
+        int sample = 0;
+        for (int k = 0; k < count; ++k) {
+            if (!((active >> k) & 1))
+                continue;
+            sample = stats.at(i0 + k, j).count;
+            thread_rng().seed_stream(render_seed, sample_stream(first_pixel + k, sample));
+            auto u = (i0 + k + random_double()) / (image_width-1);
+            auto v = (j + random_double()) / (image_height-1);
+            packet.rays[k] = cam.get_ray(u, v);
+            lane_rng[k] = thread_rng();
+        }
+
+        double t_max[ray_packet::max_size];
+        hit_record recs[ray_packet::max_size];
+        for (int k = 0; k < count; ++k)
+            t_max[k] = infinity;
+
+        thread_rng().seed_stream(render_seed, sample_stream(image_pixels + first_pixel, sample));
+        int hits = world.hit_packet(packet, active, 0.001, t_max, recs);
+
+        for (int k = 0; k < count; ++k) {
+            if (!((active >> k) & 1))
+                continue;
+            thread_rng() = lane_rng[k];
+            auto sample_color = ray_color(packet.rays[k], (hits >> k) & 1, recs[k],
+                                          background, world, max_depth, rr_depth);
+
+            auto& pixel = stats.at(i0 + k, j);
+            pixel.add(sample_color, (hits >> k) & 1);
+            image.at(i0 + k, j) += sample_color;
+            image.count_at(i0 + k, j) = pixel.count;
+        }
+
+        return true;
+    };
+
+    // Each pass adds samples to every pixel that still needs them, so the whole frame sharpens
+    // together, and a snapshot written at any point is a usable image. The first pass takes a
+    // single sample per pixel, for a quick first look. Later passes double in size up to
+    // max_pass_samples, which spends less of the time moving between pixels.
+    const int max_pass_samples = 8;
+    auto last_snapshot = std::chrono::steady_clock::now();
+    int remaining = stats.update(sampling);
+
+    for (int pass = 1, pass_samples = 1; remaining > 0 && !stop_requested; ++pass) {
+        renderer.render([&](const tile& t) {
+            if (wavefront) {
+                wavefront->render_tile(t, image, stats, pass_samples);
+                return;
+            }
+
+            for (int j = t.y0; j < t.y1; ++j) {
+                if (!use_packets) {
+                    for (int i = t.x0; i < t.x1; ++i) {
+                        for (int s = 0; s < pass_samples; ++s) {
+                            if (!sample_pixel(i, j))
+                                break;
+                        }
+                    }
+                    continue;
+                }
+
+                for (int i0 = t.x0; i0 < t.x1; i0 += ray_packet::max_size) {
+                    const int count = std::min(t.x1 - i0, static_cast<int>(ray_packet::max_size));
+                    for (int s = 0; s < pass_samples; ++s) {
+                        if (!sample_run(i0, j, count))
+                            break;
+                    }
+                }
+            }
+        });
+
+        pass_samples = std::min(2*pass_samples, max_pass_samples);
+        remaining = stats.update(sampling);
+        std::cerr << "\rPass " << pass << ", pixels remaining: " << remaining << ' ' << std::flush;
+
+        auto now = std::chrono::steady_clock::now();
+        if (remaining > 0 && std::chrono::duration<double>(now - last_snapshot).count()
+                             >= snapshot_seconds) {
+            write_output(false);
+            last_snapshot = now;
+        }
+    }
+
+    // A render stopped by a signal still writes what it has, and can be resumed from its
+    // checkpoint.
+    if (!write_output(!stop_requested))
+        return 1;
+
+    if (stop_requested) {
+        std::cerr << "\nStopped.\n";
+        return 1;
+    }
+
     std::cerr << "\nDone.\n";
 }
@@ -0,0 +1,226 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "camera.h"
+#include "framebuffer.h"
+#include "hittable.h"
+#include "material.h"
+#include "sample_stats.h"
+#include "tile_renderer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+
+struct path_queue {
+    // The live paths of a wave, stored as a structure of arrays: entry k of every vector
+    // belongs to path k. slot names the sample of the wave the path is tracing.
+    std::vector<ray> rays;
+    std::vector<color> throughput;
+    std::vector<int> slot;
+    std::vector<rng> generators;
+
+    int size() const { return static_cast<int>(rays.size()); }
+
+    void clear() {
+        rays.clear();
+        throughput.clear();
+        slot.clear();
+        generators.clear();
+    }
+
+    void push(const ray& r, const color& path_throughput, int path_slot, const rng& generator) {
+        rays.push_back(r);
+        throughput.push_back(path_throughput);
+        slot.push_back(path_slot);
+        generators.push_back(generator);
+    }
+};
+
+
+struct shading_key {
+    // Orders hits by the type of their material, then by the material itself, so each run of
+    // the shading stage calls one scatter function on one texture.
+    std::type_index type;
+    const material* mat;
+    int path;
+
+    bool operator<(const shading_key& other) const {
+        if (type != other.type) return type < other.type;
+        if (mat != other.mat) return std::less<const material*>()(mat, other.mat);
+        return path < other.path;
+    }
+};
+
+
+class wavefront_renderer {
+    // Traces a tile breadth first. Rather than following one path to its end before starting
+    // the next, it advances a wave of paths, a few for each pixel of the tile that still needs
+    // samples, one bounce at a time through separate stages: generate camera rays, intersect
+    // them all, sort the hits by material, shade them in that order, and queue the scattered
+    // rays for the next bounce. Each stage runs the same code over many paths in a row, which
+    // is kinder to the instruction cache and branch predictors than the interleaving in
+    // ray_color. A pass over the tile is split into waves of at most wave_size paths.
+    //
+    // The estimate and the random numbers are the same as ray_color's, but intersections
+    // that draw random numbers, such as in media, draw them from the path's own generator, so
+    // the image matches the recursive renderer's only statistically.
+    public:
+        wavefront_renderer(
+            const camera& cam, const hittable& world, const color& background,
+            int image_width, int image_height, int max_samples, int max_depth, int rr_depth,
+            std::uint64_t render_seed)
+          : cam(cam), world(world), background(background), image_width(image_width),
+            image_height(image_height), max_samples(max_samples), max_depth(max_depth),
+            rr_depth(rr_depth), render_seed(render_seed)
+        {}
+
+        // Adds up to samples samples to every active pixel of the tile, but none past
+        // max_samples, updating its sum in image (which must be counting samples) and its
+        // statistics in stats. Safe to call concurrently for distinct tiles.
+        void render_tile(const tile& t, framebuffer& image, frame_stats& stats, int samples) const;
+
+    public:
+        const camera& cam;
+        const hittable& world;
+        color background;
+        int image_width;
+        int image_height;
+        int max_samples;
+        int max_depth;
+        int rr_depth;
+        std::uint64_t render_seed;
+
+    private:
+        // Paths per wave. Big enough to fill each stage, small enough that the queues stay in
+        // cache.
+        static const int wave_size = 1024;
+};
+
+
+void wavefront_renderer::render_tile(
+    const tile& t, framebuffer& image, frame_stats& stats, int samples
+) const {
+    std::vector<int> pass_i, pass_j, pass_s;
+    std::vector<color> radiance;
+    std::vector<char> camera_hit;
+    path_queue current, next;
+    std::vector<hit_record> recs;
+    std::vector<shading_key> hits;
+
+    // List the samples of the pass up front, since adding them to stats moves the counts
+    // the sample numbers start from.
+    for (int j = t.y0; j < t.y1; ++j) {
+        for (int i = t.x0; i < t.x1; ++i) {
+            if (!stats.is_active(i,j))
+                continue;
+
+            const int first_sample = stats.at(i,j).count;
+            const int last_sample = std::min(first_sample + samples, max_samples);
+            for (int s = first_sample; s < last_sample; s++) {
+                pass_i.push_back(i);
+                pass_j.push_back(j);
+                pass_s.push_back(s);
+            }
+        }
+    }
+
+    // Trace them in waves of wave_size paths.
+    const int pass_size = static_cast<int>(pass_i.size());
+    for (int start = 0; start < pass_size; start += wave_size) {
+        const int wave_samples = (pass_size - start < wave_size) ? pass_size - start : wave_size;
+
+        // Generate. Every path draws from the generator of its pixel and sample number, so the
+        // image doesn't depend on the thread count, the wave size or the order of the stages.
+        current.clear();
+        for (int w = 0; w < wave_samples; w++) {
+            const int i = pass_i[start + w];
+            const int j = pass_j[start + w];
+            const auto pixel = static_cast<std::uint64_t>(j)*image_width + i;
+            thread_rng().seed_stream(render_seed, sample_stream(pixel, pass_s[start + w]));
+            auto u = (i + random_double()) / (image_width-1);
+            auto v = (j + random_double()) / (image_height-1);
+            auto r = cam.get_ray(u, v);
+            current.push(r, color(1,1,1), w, thread_rng());
+        }
+
+        radiance.assign(wave_samples, color(0,0,0));
+        camera_hit.assign(wave_samples, 0);
+
+        for (int depth = 0; depth < max_depth && current.size() > 0; depth++) {
+            // Intersect. Paths that escape pick up the background and end here.
+            const int count = current.size();
+            recs.resize(count);
+            hits.clear();
+            for (int k = 0; k < count; k++) {
+                thread_rng() = current.generators[k];
+                if (world.hit(current.rays[k], 0.001, infinity, recs[k])) {
+                    const material* mat = recs[k].mat_ptr;
+                    hits.push_back(shading_key{std::type_index(typeid(*mat)), mat, k});
+                    if (depth == 0)
+                        camera_hit[current.slot[k]] = 1;
+                } else {
+                    radiance[current.slot[k]] += current.throughput[k] * background;
+                }
+                current.generators[k] = thread_rng();
+            }
+
+            // Sort by material.
+            std::sort(hits.begin(), hits.end());
+
+            // Shade, and queue the scattered rays that survive Russian roulette.
+            next.clear();
+            for (const auto& hit : hits) {
+                const int k = hit.path;
+                const auto& rec = recs[k];
+                auto throughput = current.throughput[k];
+                thread_rng() = current.generators[k];
+
+                radiance[current.slot[k]] += throughput * hit.mat->emitted(rec.u, rec.v, rec.p);
+
+                ray scattered;
+                color attenuation;
+                if (!hit.mat->scatter(current.rays[k], rec, attenuation, scattered))
+                    continue;
+
+                throughput = throughput * attenuation;
+
+                if (depth + 1 >= rr_depth) {
+                    auto survival =
+                        fmin(fmax(throughput.x(), fmax(throughput.y(), throughput.z())), 0.95);
+                    if (random_double() >= survival)
+                        continue;
+                    throughput /= survival;
+                }
+
+                next.push(scattered, throughput, current.slot[k], thread_rng());
+            }
+
+            std::swap(current, next);
+        }
+
+        // Add the samples to their pixels in the order they were generated.
+        for (int w = 0; w < wave_samples; w++) {
+            const int i = pass_i[start + w];
+            const int j = pass_j[start + w];
+            image.at(i,j) += radiance[w];
+            stats.at(i,j).add(radiance[w], camera_hit[w] != 0);
+            image.count_at(i,j) = stats.at(i,j).count;
+        }
+    }
+}
+
+#endif
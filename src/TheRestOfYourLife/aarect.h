@@ -33,6 +33,31 @@ class xy_rect : public hittable {
             return true;
         }
 
+        virtual double pdf_value(const point3& origin, const vec3& v) const override {
+            hit_record rec;
+            if (!this->hit(ray(origin, v), 0.001, infinity, rec))
+                return 0;
+
+            auto area = (x1-x0)*(y1-y0);
+            auto distance_squared = rec.t * rec.t * v.length_squared();
+            auto cosine = fabs(dot(v, rec.normal) / v.length());
+
+            return distance_squared / (cosine * area);
+        }
+
+        virtual vec3 random(const point3& origin) const override {
+            auto random_point = point3(random_double(x0,x1), random_double(y0,y1), k);
+            return random_point - origin;
+        }
+
+        virtual double area() const override {
+            return (x1-x0)*(y1-y0);
+        }
+
+        virtual const material* surface_material() const override {
+            return mp.get();
+        }
+
     public:
         shared_ptr<material> mp;
         double x0, x1, y0, y1, k;
@@ -72,6 +97,14 @@ class xz_rect : public hittable {
             return random_point - origin;
         }
 
+        virtual double area() const override {
+            return (x1-x0)*(z1-z0);
+        }
+
+        virtual const material* surface_material() const override {
+            return mp.get();
+        }
+
     public:
         shared_ptr<material> mp;
         double x0, x1, z0, z1, k;
@@ -94,6 +127,31 @@ class yz_rect : public hittable {
             return true;
         }
 
+        virtual double pdf_value(const point3& origin, const vec3& v) const override {
+            hit_record rec;
+            if (!this->hit(ray(origin, v), 0.001, infinity, rec))
+                return 0;
+
+            auto area = (y1-y0)*(z1-z0);
+            auto distance_squared = rec.t * rec.t * v.length_squared();
+            auto cosine = fabs(dot(v, rec.normal) / v.length());
+
+            return distance_squared / (cosine * area);
+        }
+
+        virtual vec3 random(const point3& origin) const override {
+            auto random_point = point3(k, random_double(y0,y1), random_double(z0,z1));
+            return random_point - origin;
+        }
+
+        virtual double area() const override {
+            return (y1-y0)*(z1-z0);
+        }
+
+        virtual const material* surface_material() const override {
+            return mp.get();
+        }
+
     public:
         shared_ptr<material> mp;
         double y0, y1, z0, z1, k;
@@ -114,7 +172,7 @@ bool xy_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) con
     rec.t = t;
     auto outward_normal = vec3(0, 0, 1);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
+    rec.mat_ptr = mp.get();
     rec.p = r.at(t);
 
     return true;
@@ -135,7 +193,7 @@ bool xz_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) con
     rec.t = t;
     auto outward_normal = vec3(0, 1, 0);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
+    rec.mat_ptr = mp.get();
     rec.p = r.at(t);
 
     return true;
@@ -156,7 +214,7 @@ bool yz_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) con
     rec.t = t;
     auto outward_normal = vec3(1, 0, 0);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
+    rec.mat_ptr = mp.get();
     rec.p = r.at(t);
 
     return true;
@@ -22,7 +22,7 @@ class material;
 struct hit_record {
     point3 p;
     vec3 normal;
-    shared_ptr<material> mat_ptr;
+    material* mat_ptr;  // Not owned; the object that was hit keeps its material alive
     double t;
     double u;
     double v;
@@ -47,6 +47,15 @@ class hittable {
         virtual vec3 random(const vec3& o) const {
             return vec3(1,0,0);
         }
+
+        // Surface area and material, used to weight lights by the power they emit.
+        virtual double area() const {
+            return 0.0;
+        }
+
+        virtual const material* surface_material() const {
+            return nullptr;
+        }
 };
 
 
@@ -68,6 +77,22 @@ class flip_face : public hittable {
             return ptr->bounding_box(time0, time1, output_box);
         }
 
+        virtual double pdf_value(const vec3& o, const vec3& v) const override {
+            return ptr->pdf_value(o, v);
+        }
+
+        virtual vec3 random(const vec3& o) const override {
+            return ptr->random(o);
+        }
+
+        virtual double area() const override {
+            return ptr->area();
+        }
+
+        virtual const material* surface_material() const override {
+            return ptr->surface_material();
+        }
+
     public:
         shared_ptr<hittable> ptr;
 };
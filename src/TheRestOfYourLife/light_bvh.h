@@ -0,0 +1,215 @@
+#ifndef LIGHT_BVH_H
+#define LIGHT_BVH_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "light_sampler.h"
+
+#include <algorithm>
+#include <vector>
+
+
+struct light_bvh_node {
+    aabb box;
+    double power;  // Total power of the lights below this node
+    int left;      // Child node indices; -1 for a leaf
+    int right;
+    int light;     // Index into the light list for a leaf
+};
+
+
+class light_bvh : public hittable {
+    // A bounding volume hierarchy over the lights. A light is picked by walking down from the
+    // root, choosing each child with probability proportional to its estimated contribution
+    // at the shading point: its power over the squared distance to its box. Nearby lights are
+    // therefore favored over distant ones of equal power, and sampling costs one step per
+    // level of the tree.
+    public:
+        light_bvh() : depth(0) {}
+        light_bvh(const hittable_list& light_list, double time0 = 0, double time1 = 1);
+
+        virtual bool hit(
+            const ray& r, double t_min, double t_max, hit_record& rec) const override {
+            return lights.hit(r, t_min, t_max, rec);
+        }
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            return lights.bounding_box(time0, time1, output_box);
+        }
+
+        virtual double pdf_value(const point3& o, const vec3& v) const override;
+        virtual vec3 random(const point3& o) const override;
+
+    public:
+        hittable_list lights;
+        std::vector<light_bvh_node> nodes;
+        int depth;  // Levels in the tree, counting the root
+
+    private:
+        // The traversal in pdf_value holds at most one entry per level on its stack. The median
+        // splits halve the lights at every level, so no list that fits in memory comes close.
+        static const int max_depth = 64;
+
+        int build(std::vector<int>& order, size_t start, size_t end, int level,
+                  const std::vector<aabb>& boxes, const std::vector<double>& powers);
+
+        double importance(const light_bvh_node& node, const point3& p) const {
+            // Clamp the distance at the box's half diagonal, so points near or inside a box
+            // don't give it an unbounded share.
+            auto center = 0.5 * (node.box.min() + node.box.max());
+            auto half_diagonal_squared = 0.25 * (node.box.max() - node.box.min()).length_squared();
+            auto distance_squared = fmax((center - p).length_squared(), half_diagonal_squared);
+            return node.power / fmax(distance_squared, 1e-8);
+        }
+
+        // Probability of descending to the left child of an interior node from point p.
+        double left_probability(const light_bvh_node& node, const point3& p) const {
+            auto left = importance(nodes[node.left], p);
+            auto right = importance(nodes[node.right], p);
+            return (left + right > 0) ? left / (left + right) : 0.5;
+        }
+};
+
+
+light_bvh::light_bvh(const hittable_list& light_list, double time0, double time1)
+  : lights(light_list), depth(0)
+{
+    auto count = lights.objects.size();
+    if (count == 0)
+        return;
+
+    std::vector<aabb> boxes(count);
+    std::vector<double> powers(count);
+    auto total_power = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        if (!lights.objects[i]->bounding_box(time0, time1, boxes[i]))
+            std::cerr << "No bounding box in light_bvh constructor.\n";
+        powers[i] = light_power(*lights.objects[i]);
+        total_power += powers[i];
+    }
+
+    // Without any known powers, treat all lights as equally bright.
+    if (total_power <= 0)
+        std::fill(powers.begin(), powers.end(), 1.0);
+
+    std::vector<int> order(count);
+    for (size_t i = 0; i < count; i++)
+        order[i] = static_cast<int>(i);
+
+    nodes.reserve(2*count);
+    build(order, 0, count, 1, boxes, powers);
+
+    if (depth > max_depth) {
+        std::cerr << "ERROR: Light BVH is " << depth << " levels deep, more than " << max_depth
+                  << ".\n";
+        nodes.clear();
+    }
+}
+
+
+int light_bvh::build(
+    std::vector<int>& order, size_t start, size_t end, int level,
+    const std::vector<aabb>& boxes, const std::vector<double>& powers
+) {
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back(light_bvh_node());
+    depth = std::max(depth, level);
+
+    if (end - start == 1) {
+        auto light = order[start];
+        nodes[index].box = boxes[light];
+        nodes[index].power = powers[light];
+        nodes[index].left = nodes[index].right = -1;
+        nodes[index].light = light;
+        return index;
+    }
+
+    // Split at the median centroid along the longest axis of the centroids' bounds.
+    auto centroid = [&](int light) { return 0.5 * (boxes[light].min() + boxes[light].max()); };
+
+    aabb centroid_bounds(centroid(order[start]), centroid(order[start]));
+    for (size_t i = start+1; i < end; i++)
+        centroid_bounds = surrounding_box(
+            centroid_bounds, aabb(centroid(order[i]), centroid(order[i])));
+    int axis = centroid_bounds.longest_axis();
+
+    auto mid = start + (end - start)/2;
+    std::nth_element(order.begin() + start, order.begin() + mid, order.begin() + end,
+        [&](int a, int b) { return centroid(a)[axis] < centroid(b)[axis]; });
+
+    auto left = build(order, start, mid, level+1, boxes, powers);
+    auto right = build(order, mid, end, level+1, boxes, powers);
+
+    nodes[index].box = surrounding_box(nodes[left].box, nodes[right].box);
+    nodes[index].power = nodes[left].power + nodes[right].power;
+    nodes[index].left = left;
+    nodes[index].right = right;
+    nodes[index].light = -1;
+    return index;
+}
+
+
+double light_bvh::pdf_value(const point3& o, const vec3& v) const {
+    // Only lights the ray from o along v reaches have a nonzero density, so follow the
+    // branches whose boxes it hits, carrying the probability of having chosen each branch.
+    if (nodes.empty())
+        return 0;
+
+    ray r(o, v);
+    int stack[max_depth];
+    double stack_probability[max_depth];
+    int stack_size = 0;
+
+    stack[stack_size] = 0;
+    stack_probability[stack_size++] = 1.0;
+
+    auto sum = 0.0;
+    while (stack_size > 0) {
+        --stack_size;
+        const auto& node = nodes[stack[stack_size]];
+        auto probability = stack_probability[stack_size];
+
+        if (probability <= 0 || !node.box.hit(r, 0.001, infinity))
+            continue;
+
+        if (node.left < 0) {
+            sum += probability * lights.objects[node.light]->pdf_value(o, v);
+            continue;
+        }
+
+        auto p_left = left_probability(node, o);
+        stack[stack_size] = node.left;
+        stack_probability[stack_size++] = probability * p_left;
+        stack[stack_size] = node.right;
+        stack_probability[stack_size++] = probability * (1 - p_left);
+    }
+
+    return sum;
+}
+
+
+vec3 light_bvh::random(const point3& o) const {
+    if (nodes.empty())
+        return vec3(1,0,0);
+
+    int current = 0;
+    while (nodes[current].left >= 0) {
+        const auto& node = nodes[current];
+        current = (random_double() < left_probability(node, o)) ? node.left : node.right;
+    }
+
+    return lights.objects[nodes[current].light]->random(o);
+}
+
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef LIGHT_SAMPLER_H
+#define LIGHT_SAMPLER_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "alias_table.h"
+#include "color.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+
+#include <vector>
+
+
+class light_sampler : public hittable {
+    // Samples the lights in proportion to the power they emit (luminance times area) rather
+    // than uniformly, so a dim fill light doesn't get as many samples as the key light. It
+    // stands in for a hittable_list of lights wherever the integrator asks for a light
+    // direction or its density.
+    public:
+        light_sampler() {}
+        light_sampler(const hittable_list& light_list);
+
+        virtual bool hit(
+            const ray& r, double t_min, double t_max, hit_record& rec) const override {
+            return lights.hit(r, t_min, t_max, rec);
+        }
+
+        virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+            return lights.bounding_box(time0, time1, output_box);
+        }
+
+        virtual double pdf_value(const point3& o, const vec3& v) const override;
+        virtual vec3 random(const point3& o) const override;
+
+    public:
+        hittable_list lights;
+        alias_table table;
+};
+
+
+inline double light_power(const hittable& light) {
+    auto mat = light.surface_material();
+    if (!mat)
+        return 0;
+    return luminance(mat->emitted_average()) * light.area();
+}
+
+
+light_sampler::light_sampler(const hittable_list& light_list) : lights(light_list) {
+    // Lights with no emitting material or no area are never picked, unless no light has a
+    // known power, in which case the table falls back to picking uniformly.
+    std::vector<double> powers;
+    for (const auto& light : lights.objects)
+        powers.push_back(light_power(*light));
+
+    table = alias_table(powers);
+}
+
+
+double light_sampler::pdf_value(const point3& o, const vec3& v) const {
+    auto sum = 0.0;
+    for (int i = 0; i < table.size(); i++) {
+        if (table.probability(i) > 0)
+            sum += table.probability(i) * lights.objects[i]->pdf_value(o, v);
+    }
+    return sum;
+}
+
+
+vec3 light_sampler::random(const point3& o) const {
+    if (table.size() == 0)
+        return vec3(1,0,0);
+    return lights.objects[table.sample()]->random(o);
+}
+
+
+#endif
@@ -14,11 +14,19 @@
 #include "aarect.h"
 #include "box.h"
 #include "camera.h"
+#include "checkpoint.h"
 #include "color.h"
+#include "framebuffer.h"
 #include "hittable_list.h"
+#include "image_output.h"
+#include "light_bvh.h"
+#include "light_sampler.h"
 #include "material.h"
 #include "sphere.h"
+#include "tile_renderer.h"
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 
@@ -26,43 +34,95 @@ color ray_color(
     const ray& r,
     const color& background,
     const hittable& world,
-    shared_ptr<hittable> lights,
-    int depth
+    const hittable& lights,
+    int max_depth,
+    int rr_depth
 ) {
-    hit_record rec;
-
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-        return color(0,0,0);
-
-    // If the ray hits nothing, return the background color.
-    if (!world.hit(r, 0.001, infinity, rec))
-        return background;
+    // Follows the path iteratively, carrying the product of the path weights so far as its
+    // throughput. After rr_depth bounces, Russian roulette ends each path with a probability
+    // that grows as its throughput falls, and scales up the survivors to keep the estimate
+    // unbiased.
+    //
+    // Direct light reaches each diffuse vertex two ways: by sampling a direction toward the
+    // lights (next-event estimation), and by the material-sampled continuation of the path
+    // hitting an emitter. Each is weighted with the power heuristic, so whichever strategy is
+    // better for a given direction dominates.
+    color radiance(0,0,0);
+    color throughput(1,1,1);
+    ray current = r;
+
+    bool last_specular = true;  // Camera rays and specular bounces see emitters unweighted
+    point3 last_point;
+    double last_material_pdf = 0;
+
+    for (int depth = 0; depth < max_depth; depth++) {
+        hit_record rec;
+
+        // If the ray hits nothing, return the background color.
+        if (!world.hit(current, 0.001, infinity, rec))
+            return radiance + throughput * background;
+
+        scatter_record srec;
+        color emitted = rec.mat_ptr->emitted(current, rec, rec.u, rec.v, rec.p);
+
+        if (emitted.length_squared() > 0) {
+            auto weight = last_specular ? 1.0 : power_heuristic(
+                last_material_pdf, lights.pdf_value(last_point, current.direction()));
+            radiance += weight * throughput * emitted;
+        }
 
-    scatter_record srec;
-    color emitted = rec.mat_ptr->emitted(r, rec, rec.u, rec.v, rec.p);
+        if (!rec.mat_ptr->scatter(current, rec, srec))
+            return radiance;
+
+        if (srec.is_specular) {
+            throughput = throughput * srec.attenuation;
+            current = srec.specular_ray;
+            last_specular = true;
+        } else {
+            // Next-event estimation: sample a direction toward the lights and add the light
+            // arriving along it, if nothing blocks it.
+            ray to_light(rec.p, lights.random(rec.p), current.time());
+            auto light_pdf = lights.pdf_value(rec.p, to_light.direction());
+            hit_record light_rec;
+            if (light_pdf > 0 && world.hit(to_light, 0.001, infinity, light_rec)) {
+                color light_emitted = light_rec.mat_ptr->emitted(
+                    to_light, light_rec, light_rec.u, light_rec.v, light_rec.p);
+                if (light_emitted.length_squared() > 0) {
+                    auto weight = power_heuristic(
+                        light_pdf, srec.scatter_pdf.value(to_light.direction()));
+                    radiance += weight * throughput * srec.attenuation * light_emitted
+                              * rec.mat_ptr->scattering_pdf(current, rec, to_light) / light_pdf;
+                }
+            }
 
-    if (!rec.mat_ptr->scatter(r, rec, srec))
-        return emitted;
+            // Continue the path in a direction sampled from the material.
+            ray scattered(rec.p, srec.scatter_pdf.generate(), current.time());
+            auto material_pdf = srec.scatter_pdf.value(scattered.direction());
+            if (material_pdf <= 0)
+                return radiance;
+
+            throughput = throughput * srec.attenuation
+                       * rec.mat_ptr->scattering_pdf(current, rec, scattered) / material_pdf;
+            current = scattered;
+            last_specular = false;
+            last_point = rec.p;
+            last_material_pdf = material_pdf;
+        }
 
-    if (srec.is_specular) {
-        return srec.attenuation
-             * ray_color(srec.specular_ray, background, world, lights, depth-1);
+        if (depth + 1 >= rr_depth) {
+            auto survival = fmin(fmax(throughput.x(), fmax(throughput.y(), throughput.z())), 0.95);
+            if (random_double() >= survival)
+                return radiance;
+            throughput /= survival;
+        }
     }
 
-    auto light_ptr = make_shared<hittable_pdf>(lights, rec.p);
-    mixture_pdf p(light_ptr, srec.pdf_ptr);
-    ray scattered = ray(rec.p, p.generate(), r.time());
-    auto pdf_val = p.value(scattered.direction());
-
-    return emitted
-         + srec.attenuation * rec.mat_ptr->scattering_pdf(r, rec, scattered)
-                            * ray_color(scattered, background, world, lights, depth-1)
-                            / pdf_val;
+    // If we've exceeded the ray bounce limit, no more light is gathered.
+    return radiance;
 }
 
 
-hittable_list cornell_box() {
+hittable_list cornell_box(hittable_list& lights) {
     hittable_list objects;
 
     auto red   = make_shared<lambertian>(color(.65, .05, .05));
@@ -72,7 +132,9 @@ hittable_list cornell_box() {
 
     objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, green));
     objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, red));
-    objects.add(make_shared<flip_face>(make_shared<xz_rect>(213, 343, 227, 332, 554, light)));
+    auto ceiling_light = make_shared<xz_rect>(213, 343, 227, 332, 554, light);
+    objects.add(make_shared<flip_face>(ceiling_light));
+    lights.add(ceiling_light);
     objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
     objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
     objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
@@ -90,7 +152,26 @@ hittable_list cornell_box() {
 }
 
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Command line: an optional output file name, --checkpoint <file> to also write the
+    // render's checkpoint, for merging with other runs, --seed <n> to pick the
+    // random numbers of this run, and --light-bvh to pick lights with the light hierarchy.
+
+    const char* output_file = nullptr;
+    const char* checkpoint_file = nullptr;
+    std::uint64_t render_seed = 0;
+    bool use_light_bvh = false;
+    for (int arg = 1; arg < argc; ++arg) {
+        if (std::strcmp(argv[arg], "--light-bvh") == 0)
+            use_light_bvh = true;
+        else if (std::strcmp(argv[arg], "--checkpoint") == 0 && arg+1 < argc)
+            checkpoint_file = argv[++arg];
+        else if (std::strcmp(argv[arg], "--seed") == 0 && arg+1 < argc)
+            render_seed = std::strtoull(argv[++arg], nullptr, 10);
+        else
+            output_file = argv[arg];
+    }
+
     // Image
 
     const auto aspect_ratio = 1.0 / 1.0;
@@ -98,14 +179,20 @@ int main() {
     const int image_height = static_cast<int>(image_width / aspect_ratio);
     const int samples_per_pixel = 100;
     const int max_depth = 50;
+    const int rr_depth = 3;  // Bounces before Russian roulette may end a path
 
     // World
 
-    auto lights = make_shared<hittable_list>();
-    lights->add(make_shared<xz_rect>(213, 343, 227, 332, 554, shared_ptr<material>()));
-    lights->add(make_shared<sphere>(point3(190, 90, 190), 90, shared_ptr<material>()));
-
-    auto world = cornell_box();
+    // Only emitters belong in the lights list: every vertex samples it for direct light, in
+    // proportion to the power each light emits. With many lights spread through the scene,
+    // the light hierarchy also favors the ones near each shading point.
+    hittable_list light_list;
+    auto world = cornell_box(light_list);
+    shared_ptr<hittable> lights;
+    if (use_light_bvh)
+        lights = make_shared<light_bvh>(light_list);
+    else
+        lights = make_shared<light_sampler>(light_list);
 
     color background(0,0,0);
 
@@ -124,21 +211,49 @@ int main() {
 
     // Render
 
-    std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-
-    for (int j = image_height-1; j >= 0; --j) {
-        std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
-        for (int i = 0; i < image_width; ++i) {
-            color pixel_color(0,0,0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                auto u = (i + random_double()) / (image_width-1);
-                auto v = (j + random_double()) / (image_height-1);
-                ray r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, background, world, lights, max_depth);
+    framebuffer image(image_width, image_height);
+    frame_stats stats(image_width, image_height);
+    tile_renderer renderer(image_width, image_height);
+
+    renderer.render([&](const tile& t) {
+        for (int j = t.y0; j < t.y1; ++j) {
+            for (int i = t.x0; i < t.x1; ++i) {
+                // Seeding per pixel makes the image independent of the thread count.
+                thread_rng().seed_stream(render_seed, static_cast<std::uint64_t>(j)*image_width + i);
+
+                // The statistics only go into the checkpoint, which doesn't track camera hits.
+                color pixel_color(0,0,0);
+                auto& pixel_stats = stats.at(i,j);
+                for (int s = 0; s < samples_per_pixel; ++s) {
+                    auto u = (i + random_double()) / (image_width-1);
+                    auto v = (j + random_double()) / (image_height-1);
+                    ray r = cam.get_ray(u, v);
+                    auto sample = ray_color(r, background, world, *lights, max_depth, rr_depth);
+                    pixel_color += sample;
+                    pixel_stats.add(sample, true);
+                }
+                image.at(i,j) = pixel_color;
+                stats.active[static_cast<size_t>(j)*image_width + i] = 0;
             }
-            write_color(std::cout, pixel_color, samples_per_pixel);
         }
-    }
+    });
+
+    // Write the image to the file named on the command line, in the format given by its
+    // extension, or as binary PPM to standard output.
+    bool written = output_file ? write_image(output_file, image, samples_per_pixel)
+                               : write_ppm(image, samples_per_pixel);
+    if (!written)
+        return 1;
+
+    // Every pixel takes all of its samples, which the checkpoint records as sampling without an
+    // early stop.
+    adaptive_sampling sampling;
+    sampling.min_samples = sampling.max_samples = samples_per_pixel;
+    sampling.max_error = sampling.min_luminance = 0;
+
+    if (checkpoint_file
+        && !render_checkpoint(image, stats, sampling, render_seed).write(checkpoint_file))
+        return 1;
 
     std::cerr << "\nDone.\n";
 }
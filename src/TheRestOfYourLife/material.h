@@ -21,7 +21,7 @@ struct scatter_record {
     ray specular_ray;
     bool is_specular;
     color attenuation;
-    shared_ptr<pdf> pdf_ptr;
+    cosine_pdf scatter_pdf;  // Held by value; only meaningful when is_specular is false
 };
 
 
@@ -44,6 +44,11 @@ class material {
         ) const {
             return 0;
         }
+
+        // Average radiance emitted from the front face, for weighting lights by power.
+        virtual color emitted_average() const {
+            return color(0,0,0);
+        }
 };
 
 
@@ -57,7 +62,7 @@ class lambertian : public material {
         ) const override {
             srec.is_specular = false;
             srec.attenuation = albedo->value(rec.u, rec.v, rec.p);
-            srec.pdf_ptr = make_shared<cosine_pdf>(rec.normal);
+            srec.scatter_pdf = cosine_pdf(rec.normal);
             return true;
         }
 
@@ -85,7 +90,6 @@ class metal : public material {
                 ray(rec.p, reflected + fuzz*random_in_unit_sphere(), r_in.time());
             srec.attenuation = albedo;
             srec.is_specular = true;
-            srec.pdf_ptr = nullptr;
             return true;
         }
 
@@ -103,7 +107,6 @@ class dielectric : public material {
             const ray& r_in, const hit_record& rec, scatter_record& srec
         ) const override {
             srec.is_specular = true;
-            srec.pdf_ptr = nullptr;
             srec.attenuation = color(1.0, 1.0, 1.0);
             double refraction_ratio = rec.front_face ? (1.0/ir) : ir;
 
@@ -149,6 +152,11 @@ class diffuse_light : public material {
             return emit->value(u, v, p);
         }
 
+        virtual color emitted_average() const override {
+            // Exact for solid colors; other textures are sampled at their center.
+            return emit->value(0.5, 0.5, point3(0,0,0));
+        }
+
     public:
         shared_ptr<texture> emit;
 };
@@ -42,6 +42,15 @@ inline vec3 random_to_sphere(double radius, double distance_squared) {
 }
 
 
+inline double power_heuristic(double pdf_f, double pdf_g) {
+    // Multiple importance sampling weight for a sample drawn from f, when g could also have
+    // drawn it.
+    auto f2 = pdf_f*pdf_f;
+    auto g2 = pdf_g*pdf_g;
+    return (f2 + g2 > 0) ? f2 / (f2 + g2) : 0;
+}
+
+
 class pdf  {
     public:
         virtual ~pdf() {}
@@ -53,6 +62,7 @@ class pdf  {
 
 class cosine_pdf : public pdf {
     public:
+        cosine_pdf() {}
         cosine_pdf(const vec3& w) { uvw.build_from_w(w); }
 
         virtual double value(const vec3& direction) const override {
@@ -69,9 +79,12 @@ class cosine_pdf : public pdf {
 };
 
 
+// The hittable and mixture PDFs only refer to their parts, so they can be built on the stack for
+// each bounce without any allocation. The referenced objects must outlive them.
+
 class hittable_pdf : public pdf {
     public:
-        hittable_pdf(shared_ptr<hittable> p, const point3& origin) : ptr(p), o(origin) {}
+        hittable_pdf(const hittable& p, const point3& origin) : o(origin), ptr(&p) {}
 
         virtual double value(const vec3& direction) const override {
             return ptr->pdf_value(o, direction);
@@ -83,15 +96,15 @@ class hittable_pdf : public pdf {
 
     public:
         point3 o;
-        shared_ptr<hittable> ptr;
+        const hittable* ptr;
 };
 
 
 class mixture_pdf : public pdf {
     public:
-        mixture_pdf(shared_ptr<pdf> p0, shared_ptr<pdf> p1) {
-            p[0] = p0;
-            p[1] = p1;
+        mixture_pdf(const pdf& p0, const pdf& p1) {
+            p[0] = &p0;
+            p[1] = &p1;
         }
 
         virtual double value(const vec3& direction) const override {
@@ -106,7 +119,7 @@ class mixture_pdf : public pdf {
         }
 
     public:
-        shared_ptr<pdf> p[2];
+        const pdf* p[2];
 };
 
 
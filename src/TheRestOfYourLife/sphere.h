@@ -31,6 +31,14 @@ class sphere : public hittable {
         virtual double pdf_value(const point3& o, const vec3& v) const override;
         virtual vec3 random(const point3& o) const override;
 
+        virtual double area() const override {
+            return 4*pi*radius*radius;
+        }
+
+        virtual const material* surface_material() const override {
+            return mat_ptr.get();
+        }
+
     public:
         point3 center;
         double radius;
@@ -104,7 +112,7 @@ bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) cons
     vec3 outward_normal = (rec.p - center) / radius;
     rec.set_face_normal(r, outward_normal);
     get_sphere_uv(outward_normal, rec.u, rec.v);
-    rec.mat_ptr = mat_ptr;
+    rec.mat_ptr = mat_ptr.get();
 
     return true;
 }
@@ -13,6 +13,9 @@
 
 #include "rtweekend.h"
 
+#include <cmath>
+#include <limits>
+
 
 class aabb {
     public:
@@ -23,17 +26,16 @@ class aabb {
         point3 max() const {return maximum; }
 
         bool hit(const ray& r, double t_min, double t_max) const {
+            // The ray's sign bits pick the near and far slab planes, so there is no division,
+            // swap or early exit. A NaN from a ray lying in a slab plane (0 * inf) fails both
+            // comparisons and leaves the interval unchanged.
             for (int a = 0; a < 3; a++) {
-                auto t0 = fmin((minimum[a] - r.origin()[a]) / r.direction()[a],
-                               (maximum[a] - r.origin()[a]) / r.direction()[a]);
-                auto t1 = fmax((minimum[a] - r.origin()[a]) / r.direction()[a],
-                               (maximum[a] - r.origin()[a]) / r.direction()[a]);
-                t_min = fmax(t0, t_min);
-                t_max = fmin(t1, t_max);
-                if (t_max <= t_min)
-                    return false;
+                auto t0 = ((r.sign(a) ? maximum : minimum)[a] - r.orig[a]) * r.inv_dir[a];
+                auto t1 = ((r.sign(a) ? minimum : maximum)[a] - r.orig[a]) * r.inv_dir[a];
+                t_min = t0 > t_min ? t0 : t_min;
+                t_max = t1 < t_max ? t1 : t_max;
             }
-            return true;
+            return t_min < t_max;
         }
 
         double area() const {
@@ -73,4 +75,57 @@ aabb surrounding_box(aabb box0, aabb box1) {
 }
 
 
+class aabb4 {
+    // Four boxes stored axis by axis, so one pass of the slab test covers all of them and the
+    // compiler is free to do the four lanes in parallel. Bounds are kept in single precision,
+    // rounded outwards so each lane still contains the box it was set from. Unused lanes are
+    // empty and never hit.
+    public:
+        aabb4() {
+            for (int a = 0; a < 3; a++) {
+                for (int i = 0; i < 4; i++) {
+                    minimum[a][i] =  std::numeric_limits<float>::infinity();
+                    maximum[a][i] = -std::numeric_limits<float>::infinity();
+                }
+            }
+        }
+
+        void set(int lane, const aabb& box) {
+            const auto inf = std::numeric_limits<float>::infinity();
+            for (int a = 0; a < 3; a++) {
+                minimum[a][lane] = std::nextafter(static_cast<float>(box.min()[a]), -inf);
+                maximum[a][lane] = std::nextafter(static_cast<float>(box.max()[a]),  inf);
+            }
+        }
+
+        // Returns a mask with bit i set when the ray hits box i within [t_min, t_max].
+        int hit(const ray& r, double t_min, double t_max) const {
+            double near[4] = { t_min, t_min, t_min, t_min };
+            double far[4]  = { t_max, t_max, t_max, t_max };
+
+            for (int a = 0; a < 3; a++) {
+                const float* lo = r.sign(a) ? maximum[a] : minimum[a];
+                const float* hi = r.sign(a) ? minimum[a] : maximum[a];
+                auto origin = r.orig[a];
+                auto inv_dir = r.inv_dir[a];
+                for (int i = 0; i < 4; i++) {
+                    double t0 = (lo[i] - origin) * inv_dir;
+                    double t1 = (hi[i] - origin) * inv_dir;
+                    near[i] = t0 > near[i] ? t0 : near[i];
+                    far[i]  = t1 < far[i]  ? t1 : far[i];
+                }
+            }
+
+            int mask = 0;
+            for (int i = 0; i < 4; i++)
+                mask |= (near[i] < far[i]) << i;
+            return mask;
+        }
+
+    public:
+        float minimum[3][4];
+        float maximum[3][4];
+};
+
+
 #endif
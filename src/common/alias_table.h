@@ -0,0 +1,96 @@
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include <vector>
+
+
+class alias_table {
+    // Samples index i with probability weights[i] / sum(weights) in constant time, using
+    // Vose's alias method: each of the n equally likely slots holds its own index with some
+    // probability, and one other "alias" index otherwise.
+    public:
+        alias_table() {}
+        alias_table(const std::vector<double>& weights);
+
+        int size() const { return static_cast<int>(pmf.size()); }
+
+        // Probability of sampling index i.
+        double probability(int i) const { return pmf[i]; }
+
+        // Maps a uniform number in [0,1) to an index.
+        int sample(double u) const {
+            auto scaled = u * size();
+            auto slot = static_cast<int>(scaled);
+            if (slot >= size())
+                slot = size() - 1;
+            return (scaled - slot < accept[slot]) ? slot : alias[slot];
+        }
+
+        int sample() const { return sample(random_double()); }
+
+    public:
+        std::vector<double> pmf;
+        std::vector<double> accept;  // Chance that a slot yields its own index
+        std::vector<int> alias;
+};
+
+
+alias_table::alias_table(const std::vector<double>& weights) {
+    auto n = static_cast<int>(weights.size());
+    if (n == 0)
+        return;
+
+    auto total = 0.0;
+    for (auto w : weights)
+        total += (w > 0) ? w : 0;
+
+    // With no positive weights, fall back to picking uniformly.
+    pmf.resize(n);
+    for (int i = 0; i < n; i++)
+        pmf[i] = (total > 0) ? ((weights[i] > 0) ? weights[i] : 0) / total : 1.0 / n;
+
+    // Scale so the average slot holds 1, then fill each underfull slot from an overfull one.
+    accept.resize(n);
+    alias.resize(n);
+    std::vector<double> scaled(n);
+    std::vector<int> small, large;
+    for (int i = 0; i < n; i++) {
+        scaled[i] = pmf[i] * n;
+        alias[i] = i;
+        if (scaled[i] < 1)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        auto s = small.back(); small.pop_back();
+        auto l = large.back(); large.pop_back();
+
+        accept[s] = scaled[s];
+        alias[s] = l;
+
+        scaled[l] = (scaled[l] + scaled[s]) - 1;
+        if (scaled[l] < 1)
+            small.push_back(l);
+        else
+            large.push_back(l);
+    }
+
+    // Whatever is left is full up to rounding error.
+    for (auto i : large) accept[i] = 1;
+    for (auto i : small) accept[i] = 1;
+}
+
+
+#endif
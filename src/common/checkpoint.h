@@ -0,0 +1,280 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "color.h"
+#include "framebuffer.h"
+#include "image_output.h"
+#include "sample_stats.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// A checkpoint holds everything a progressive render needs to carry on where it left off: the
+// image size, seed and sampling settings it was started with, and for every pixel its sample
+// sum and statistics.
+// It also carries the sum of the squared luminances of each pixel's samples, so checkpoints of
+// independent runs of the same scene with different seeds can be merged into one render with
+// all of their samples, for splitting a render over many machines.
+//
+// The file is a header followed by one record per pixel, in framebuffer order, bottom scanline
+// first. Values are written in the byte order of the machine, so resume and merge on the same
+// kind of machine.
+//
+//     char[8]   "RTWCKPT3"
+//     int32     width, height
+//     uint64    seed of the run, or of the first run merged
+//     uint32    number of runs merged
+//     int32     fewest and most samples a pixel takes, summed over the runs merged
+//     float64   relative error and luminance floor at which a pixel stops (see
+//               adaptive_sampling), of the first run merged
+//
+//     float64   sum of the samples: red, green, blue
+//     int32     number of samples
+//     int32     number of samples whose camera ray hit the scene, or the number of samples
+//               where the renderer doesn't track it
+//     float64   mean and Welford sum of squared differences of the samples' luminances
+//     float64   sum of the squared luminances of the samples
+//     uint8     1 if the pixel still needs samples
+//
+// The statistics are stored as the render kept them, so a resumed render makes the same stop
+// decisions as one that was never interrupted.
+
+const char checkpoint_magic[8] = {'R','T','W','C','K','P','T','3'};
+
+
+struct checkpoint_pixel {
+    color sum;
+    sample_stats stats;
+    double sum_squares;
+    std::uint8_t active;
+};
+
+
+class render_checkpoint {
+    public:
+        render_checkpoint() : width(0), height(0), seed(0), runs(1), sampling() {}
+
+        // The checkpoint of a render whose samples have been summed into image, with their
+        // statistics in stats.
+        render_checkpoint(
+            const framebuffer& image, const frame_stats& stats, const adaptive_sampling& sampling,
+            std::uint64_t render_seed);
+
+        bool read(const std::string& filename);
+        bool write(const std::string& filename) const;
+
+        // Sets image and stats to the state of the render when the checkpoint was taken.
+        void restore(framebuffer& image, frame_stats& stats) const;
+
+        // Adds the samples of another run of the same image size. Returns false, and leaves
+        // this checkpoint alone, if the sizes differ.
+        bool merge(const render_checkpoint& other);
+
+        // The image so far, with each pixel's sample count.
+        framebuffer image() const;
+
+    public:
+        int width;
+        int height;
+        std::uint64_t seed;
+        std::uint32_t runs;
+        adaptive_sampling sampling;
+        std::vector<checkpoint_pixel> pixels;
+};
+
+
+template <typename T>
+void write_value(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+
+template <typename T>
+bool read_value(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return in.good();
+}
+
+
+render_checkpoint::render_checkpoint(
+    const framebuffer& image, const frame_stats& stats, const adaptive_sampling& sampling,
+    std::uint64_t render_seed
+) : width(image.width), height(image.height), seed(render_seed), runs(1), sampling(sampling),
+    pixels(image.pixels.size())
+{
+    for (size_t p = 0; p < pixels.size(); p++) {
+        auto& pixel = pixels[p];
+        pixel.sum = image.pixels[p];
+        pixel.stats = stats.pixels[p];
+        // Summing squares can cancel badly when the statistics are taken back out of them, but
+        // putting them together from the mean and m2 is safe.
+        auto mean = pixel.stats.mean;
+        pixel.sum_squares = pixel.stats.m2 + pixel.stats.count * mean * mean;
+        pixel.active = stats.active[p];
+    }
+}
+
+
+bool render_checkpoint::read(const std::string& filename) {
+    // Returns false, and leaves this checkpoint alone, if there is no such file or it is not
+    // a complete checkpoint.
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        return false;
+
+    char magic[sizeof(checkpoint_magic)];
+    std::int32_t file_width, file_height, min_samples, max_samples;
+    render_checkpoint file;
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0
+        || !read_value(in, file_width) || !read_value(in, file_height)
+        || !read_value(in, file.seed) || !read_value(in, file.runs)
+        || !read_value(in, min_samples) || !read_value(in, max_samples)
+        || !read_value(in, file.sampling.max_error)
+        || !read_value(in, file.sampling.min_luminance)
+        || file_width <= 0 || file_height <= 0) {
+        std::cerr << "ERROR: '" << filename << "' is not a checkpoint file.\n";
+        return false;
+    }
+
+    file.width = file_width;
+    file.height = file_height;
+    file.sampling.min_samples = min_samples;
+    file.sampling.max_samples = max_samples;
+    file.pixels.resize(static_cast<size_t>(file_width) * file_height);
+
+    for (auto& pixel : file.pixels) {
+        double r, g, b;
+        std::int32_t count, hits;
+        if (!read_value(in, r) || !read_value(in, g) || !read_value(in, b)
+            || !read_value(in, count) || !read_value(in, hits)
+            || !read_value(in, pixel.stats.mean) || !read_value(in, pixel.stats.m2)
+            || !read_value(in, pixel.sum_squares) || !read_value(in, pixel.active)) {
+            std::cerr << "ERROR: Checkpoint '" << filename << "' is truncated.\n";
+            return false;
+        }
+        pixel.sum = color(r, g, b);
+        pixel.stats.count = count;
+        pixel.stats.hits = hits;
+    }
+
+    *this = file;
+    return true;
+}
+
+
+bool render_checkpoint::write(const std::string& filename) const {
+    // Like the images, the checkpoint is written to a partial file and then moved into place,
+    // so the render can be killed at any moment without losing the previous checkpoint.
+    auto partial = partial_filename(filename);
+
+    bool ok;
+    {
+        std::ofstream out(partial, std::ios::binary);
+        out.write(checkpoint_magic, sizeof(checkpoint_magic));
+        write_value(out, static_cast<std::int32_t>(width));
+        write_value(out, static_cast<std::int32_t>(height));
+        write_value(out, seed);
+        write_value(out, runs);
+        write_value(out, static_cast<std::int32_t>(sampling.min_samples));
+        write_value(out, static_cast<std::int32_t>(sampling.max_samples));
+        write_value(out, sampling.max_error);
+        write_value(out, sampling.min_luminance);
+
+        for (const auto& pixel : pixels) {
+            write_value(out, pixel.sum.x());
+            write_value(out, pixel.sum.y());
+            write_value(out, pixel.sum.z());
+            write_value(out, static_cast<std::int32_t>(pixel.stats.count));
+            write_value(out, static_cast<std::int32_t>(pixel.stats.hits));
+            write_value(out, pixel.stats.mean);
+            write_value(out, pixel.stats.m2);
+            write_value(out, pixel.sum_squares);
+            write_value(out, pixel.active);
+        }
+
+        out.flush();
+        ok = out.good();
+    }
+
+    ok = ok && replace_file(partial, filename);
+
+    if (!ok)
+        std::cerr << "ERROR: Could not write checkpoint file '" << filename << "'.\n";
+
+    return ok;
+}
+
+
+void render_checkpoint::restore(framebuffer& image, frame_stats& stats) const {
+    image = this->image();
+
+    for (size_t p = 0; p < pixels.size(); p++) {
+        stats.pixels[p] = pixels[p].stats;
+        stats.active[p] = pixels[p].active;
+    }
+}
+
+
+bool render_checkpoint::merge(const render_checkpoint& other) {
+    if (other.width != width || other.height != height)
+        return false;
+
+    for (size_t p = 0; p < pixels.size(); p++) {
+        auto& pixel = pixels[p];
+        const auto& more = other.pixels[p];
+        pixel.sum += more.sum;
+        pixel.sum_squares += more.sum_squares;
+        pixel.active = pixel.active || more.active;
+
+        // Chan et al.'s pairwise update combines the two runs' means and m2 without going
+        // through the sums of squares.
+        auto& a = pixel.stats;
+        const auto& b = more.stats;
+        auto count = a.count + b.count;
+        if (count > 0) {
+            auto delta = b.mean - a.mean;
+            auto weight = static_cast<double>(b.count) / count;
+            a.mean += delta * weight;
+            a.m2 += b.m2 + delta * delta * a.count * weight;
+        }
+        a.count = count;
+        a.hits += b.hits;
+    }
+
+    sampling.min_samples += other.sampling.min_samples;
+    sampling.max_samples += other.sampling.max_samples;
+    runs += other.runs;
+    return true;
+}
+
+
+framebuffer render_checkpoint::image() const {
+    framebuffer result(width, height);
+    result.count_samples();
+
+    for (size_t p = 0; p < pixels.size(); p++) {
+        result.pixels[p] = pixels[p].sum;
+        result.counts[p] = pixels[p].stats.count;
+    }
+
+    return result;
+}
+
+
+#endif
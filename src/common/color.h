@@ -16,7 +16,7 @@
 #include <iostream>
 
 
-void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
+color average_color(color pixel_color, int samples_per_pixel) {
     auto r = pixel_color.x();
     auto g = pixel_color.y();
     auto b = pixel_color.z();
@@ -26,16 +26,31 @@ void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
     if (g != g) g = 0.0;
     if (b != b) b = 0.0;
 
-    // Divide the color by the number of samples and gamma-correct for gamma=2.0.
+    // Divide the color by the number of samples.
     auto scale = 1.0 / samples_per_pixel;
-    r = sqrt(scale * r);
-    g = sqrt(scale * g);
-    b = sqrt(scale * b);
+    return color(scale * r, scale * g, scale * b);
+}
+
+
+inline double luminance(const color& c) {
+    // Relative luminance of linear Rec. 709 RGB.
+    return 0.2126*c.x() + 0.7152*c.y() + 0.0722*c.z();
+}
+
+
+int color_byte(double linear_component) {
+    // Gamma-correct for gamma=2.0 and return the translated [0,255] value.
+    return static_cast<int>(256 * clamp(sqrt(linear_component), 0.0, 0.999));
+}
+
+
+void write_color(std::ostream &out, color pixel_color, int samples_per_pixel) {
+    auto c = average_color(pixel_color, samples_per_pixel);
 
     // Write the translated [0,255] value of each color component.
-    out << static_cast<int>(256 * clamp(r, 0.0, 0.999)) << ' '
-        << static_cast<int>(256 * clamp(g, 0.0, 0.999)) << ' '
-        << static_cast<int>(256 * clamp(b, 0.0, 0.999)) << '\n';
+    out << color_byte(c.x()) << ' '
+        << color_byte(c.y()) << ' '
+        << color_byte(c.z()) << '\n';
 }
 
 
@@ -0,0 +1,49 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include <vector>
+
+
+class framebuffer {
+    public:
+        framebuffer(int image_width, int image_height)
+          : width(image_width), height(image_height),
+            pixels(static_cast<size_t>(image_width) * image_height, color(0,0,0))
+        {}
+
+        // Pixel (i,j) uses the same convention as the render loop: i runs left to right, and j
+        // runs from the bottom scanline (0) to the top scanline (height-1).
+        color& at(int i, int j)             { return pixels[static_cast<size_t>(j)*width + i]; }
+        const color& at(int i, int j) const { return pixels[static_cast<size_t>(j)*width + i]; }
+
+        // Starts keeping a sample count per pixel, for renders where it varies from pixel to
+        // pixel. Call before rendering, then set each pixel's count with count_at.
+        void count_samples() { counts.assign(pixels.size(), 0); }
+
+        int& count_at(int i, int j) { return counts[static_cast<size_t>(j)*width + i]; }
+
+        // The number of samples summed into pixel (i,j): the recorded count if there is one,
+        // or else samples_per_pixel.
+        int samples(int i, int j, int samples_per_pixel) const {
+            return counts.empty() ? samples_per_pixel : counts[static_cast<size_t>(j)*width + i];
+        }
+
+    public:
+        int width;
+        int height;
+        std::vector<color> pixels;  // Accumulated (unscaled) sample sums
+        std::vector<int> counts;    // Samples per pixel; empty when all take the same number
+};
+
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef IMAGE_OUTPUT_H
+#define IMAGE_OUTPUT_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "color.h"
+#include "framebuffer.h"
+#include "rtw_stb_image_write.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+
+
+// Image rows are written top scanline first. Each function converts the whole framebuffer in one
+// pass and hands the result to the output in a single bulk write.
+
+std::vector<unsigned char> image_bytes(const framebuffer& image, int samples_per_pixel) {
+    // Gamma-corrected 8-bit RGB.
+    std::vector<unsigned char> bytes;
+    bytes.reserve(3 * image.pixels.size());
+
+    for (int j = image.height-1; j >= 0; --j) {
+        for (int i = 0; i < image.width; ++i) {
+            auto c = average_color(image.at(i,j), image.samples(i, j, samples_per_pixel));
+            bytes.push_back(static_cast<unsigned char>(color_byte(c.x())));
+            bytes.push_back(static_cast<unsigned char>(color_byte(c.y())));
+            bytes.push_back(static_cast<unsigned char>(color_byte(c.z())));
+        }
+    }
+
+    return bytes;
+}
+
+
+std::vector<float> image_floats(const framebuffer& image, int samples_per_pixel) {
+    // Linear (not gamma-corrected) RGB, for high dynamic range formats.
+    std::vector<float> floats;
+    floats.reserve(3 * image.pixels.size());
+
+    for (int j = image.height-1; j >= 0; --j) {
+        for (int i = 0; i < image.width; ++i) {
+            auto c = average_color(image.at(i,j), image.samples(i, j, samples_per_pixel));
+            floats.push_back(static_cast<float>(c.x()));
+            floats.push_back(static_cast<float>(c.y()));
+            floats.push_back(static_cast<float>(c.z()));
+        }
+    }
+
+    return floats;
+}
+
+
+framebuffer sample_heatmap(const framebuffer& image, int samples_per_pixel, int max_samples) {
+    // False-color map of the samples each pixel took, running from black for none through red
+    // and yellow to white for max_samples. Write it with one sample per pixel.
+    framebuffer heatmap(image.width, image.height);
+
+    for (int j = 0; j < image.height; ++j) {
+        for (int i = 0; i < image.width; ++i) {
+            auto x = 3.0 * image.samples(i, j, samples_per_pixel) / max_samples;
+            heatmap.at(i,j) = color(clamp(x, 0.0, 1.0), clamp(x-1, 0.0, 1.0), clamp(x-2, 0.0, 1.0));
+        }
+    }
+
+    return heatmap;
+}
+
+
+bool write_ppm(std::ostream& out, const framebuffer& image, int samples_per_pixel) {
+    // Binary (P6) PPM.
+    auto header = "P6\n" + std::to_string(image.width) + ' ' + std::to_string(image.height)
+                + "\n255\n";
+    auto bytes = image_bytes(image, samples_per_pixel);
+
+    out.write(header.data(), header.size());
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    out.flush();
+    return out.good();
+}
+
+
+bool write_ppm(const framebuffer& image, int samples_per_pixel) {
+    // Binary PPM to standard output, which must not translate line endings.
+    #ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+    #endif
+    return write_ppm(std::cout, image, samples_per_pixel);
+}
+
+
+std::string partial_filename(const std::string& filename) {
+    // The name a file is written under before it replaces filename. It keeps the extension,
+    // which picks the image format.
+    auto dot = filename.rfind('.');
+    auto slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return filename + ".partial";
+    return filename.substr(0, dot) + ".partial" + filename.substr(dot);
+}
+
+
+bool replace_file(const std::string& partial, const std::string& filename) {
+    // Moves the finished partial file over filename. On POSIX systems the rename is atomic, so
+    // anyone reading filename sees either the old file or the new one, never half of one.
+    #ifdef _WIN32
+        std::remove(filename.c_str());
+    #endif
+    if (std::rename(partial.c_str(), filename.c_str()) == 0)
+        return true;
+    std::remove(partial.c_str());
+    return false;
+}
+
+
+bool write_image(const std::string& filename, const framebuffer& image, int samples_per_pixel) {
+    // Writes the image in the format given by the file extension: ".png", ".hdr" (Radiance RGBE,
+    // linear), or binary PPM for anything else. The image is written to a partial file first
+    // and then moved into place, so an interrupted write leaves any earlier image intact.
+    auto dot = filename.rfind('.');
+    auto extension = (dot == std::string::npos) ? std::string() : filename.substr(dot);
+    auto partial = partial_filename(filename);
+
+    bool ok;
+    if (extension == ".png") {
+        auto bytes = image_bytes(image, samples_per_pixel);
+        ok = stbi_write_png(
+            partial.c_str(), image.width, image.height, 3, bytes.data(), 3*image.width) != 0;
+    } else if (extension == ".hdr") {
+        auto floats = image_floats(image, samples_per_pixel);
+        ok = stbi_write_hdr(partial.c_str(), image.width, image.height, 3, floats.data()) != 0;
+    } else {
+        std::ofstream out(partial, std::ios::binary);
+        ok = out && write_ppm(out, image, samples_per_pixel);
+    }
+
+    ok = ok && replace_file(partial, filename);
+
+    if (!ok)
+        std::cerr << "ERROR: Could not write image file '" << filename << "'.\n";
+
+    return ok;
+}
+
+
+#endif
@@ -0,0 +1,77 @@
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "checkpoint.h"
+#include "image_output.h"
+
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+
+// Adds up the checkpoints of independent runs of the same scene, as written by theNextWeek and
+// theRestOfYourLife with --checkpoint, into one checkpoint and, optionally, the image it makes.
+
+int main(int argc, char** argv) {
+    std::string image_file;
+    std::vector<std::string> files;
+
+    for (int a = 1; a < argc; a++) {
+        if (std::strcmp(argv[a], "--image") == 0 && a + 1 < argc)
+            image_file = argv[++a];
+        else
+            files.push_back(argv[a]);
+    }
+
+    if (files.size() < 2) {
+        std::cerr << "Usage: merge_runs [--image <file>] <output> <input>...\n";
+        return 1;
+    }
+
+    render_checkpoint merged;
+    std::set<std::uint64_t> seeds;
+
+    for (size_t f = 1; f < files.size(); f++) {
+        render_checkpoint run;
+        if (!run.read(files[f])) {
+            std::cerr << "ERROR: Could not read checkpoint '" << files[f] << "'.\n";
+            return 1;
+        }
+
+        // Runs rendered with the same seed trace the same paths, so merging them adds no
+        // information, only the same noise counted twice.
+        if (!seeds.insert(run.seed).second)
+            std::cerr << "Warning: '" << files[f] << "' repeats seed " << run.seed << ".\n";
+
+        if (f == 1) {
+            merged = run;
+        } else if (!merged.merge(run)) {
+            std::cerr << "ERROR: '" << files[f] << "' is " << run.width << 'x' << run.height
+                      << ", not " << merged.width << 'x' << merged.height << ".\n";
+            return 1;
+        }
+    }
+
+    if (!merged.write(files[0]))
+        return 1;
+
+    if (!image_file.empty() && !write_image(image_file, merged.image(), 1))
+        return 1;
+
+    std::uint64_t samples = 0;
+    for (const auto& pixel : merged.pixels)
+        samples += pixel.stats.count;
+
+    std::cerr << "Merged " << merged.runs << " runs, "
+              << static_cast<double>(samples) / merged.pixels.size() << " samples per pixel.\n";
+}
@@ -19,24 +19,42 @@ class ray {
         ray() {}
         ray(const point3& origin, const vec3& direction)
             : orig(origin), dir(direction), tm(0)
-        {}
+        {
+            set_inverse();
+        }
 
         ray(const point3& origin, const vec3& direction, double time)
             : orig(origin), dir(direction), tm(time)
-        {}
+        {
+            set_inverse();
+        }
 
         point3 origin() const  { return orig; }
         vec3 direction() const { return dir; }
         double time() const    { return tm; }
 
+        // The reciprocal of each direction component, and whether it is negative. Bounding box
+        // tests use these to multiply instead of divide and to pick the near slab directly.
+        // The reciprocal is worked out once here rather than at every box a ray is tested
+        // against: the recursive bvh_node tests each of its nodes through a virtual call, so
+        // there is no one place per traversal to compute it.
+        vec3 inverse_direction() const { return inv_dir; }
+        int sign(int axis) const       { return inv_dir[axis] < 0; }
+
         point3 at(double t) const {
             return orig + t*dir;
         }
 
+    private:
+        void set_inverse() {
+            inv_dir = vec3(1/dir.x(), 1/dir.y(), 1/dir.z());
+        }
+
     public:
         point3 orig;
         vec3 dir;
         double tm;
+        vec3 inv_dir;
 };
 
 #endif
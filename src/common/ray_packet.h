@@ -0,0 +1,54 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "ray.h"
+
+
+struct ray_packet {
+    // A small group of rays traced together, such as the camera rays of neighboring pixels.
+    // Functions that take a packet also take a lane mask: bit i selects rays[i].
+    static const int max_size = 8;
+
+    ray rays[max_size];
+    int size = 0;
+
+    int full_mask() const { return (1 << size) - 1; }
+
+    // True when the selected rays point the same way along every axis, so a single near-to-far
+    // child order suits all of them during traversal.
+    bool coherent(int mask) const {
+        int first = -1;
+        for (int i = 0; i < size; i++) {
+            if (!((mask >> i) & 1))
+                continue;
+            if (first < 0) {
+                first = i;
+                continue;
+            }
+            for (int a = 0; a < 3; a++) {
+                if (rays[i].sign(a) != rays[first].sign(a))
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+
+inline int lane_count(int mask) {
+    int count = 0;
+    for (; mask; mask &= mask - 1)
+        count++;
+    return count;
+}
+
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef RNG_H
+#define RNG_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include <cstdint>
+
+
+class rng {
+    // A PCG32 generator (XSH-RR output on a 64-bit LCG). Every stream selects a distinct LCG
+    // increment, so generators seeded with the same seed but different streams never overlap.
+    public:
+        rng() { seed(0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL); }
+        rng(std::uint64_t seed_value, std::uint64_t stream = 0) { seed(seed_value, stream); }
+
+        void seed(std::uint64_t seed_value, std::uint64_t stream = 0) {
+            state = 0;
+            inc = (stream << 1u) | 1u;
+            next_uint32();
+            state += seed_value;
+            next_uint32();
+        }
+
+        std::uint32_t next_uint32() {
+            std::uint64_t old_state = state;
+            state = old_state * 6364136223846793005ULL + inc;
+            auto xorshifted = static_cast<std::uint32_t>(((old_state >> 18u) ^ old_state) >> 27u);
+            auto rot = static_cast<std::uint32_t>(old_state >> 59u);
+            return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31u));
+        }
+
+        double next_double() {
+            // Returns a random real in [0,1).
+            return next_uint32() * (1.0 / 4294967296.0);
+        }
+
+        void seed_stream(std::uint64_t render_seed, std::uint64_t item) {
+            // Seeds the generator for one unit of work (a pixel, a tile) of a render, so the
+            // numbers it produces depend only on the render seed and the item.
+            seed(mix(render_seed ^ mix(item)), item);
+        }
+
+        static std::uint64_t mix(std::uint64_t x) {
+            // SplitMix64 finalizer, for deriving well-spread seeds from small integers.
+            x += 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+    private:
+        std::uint64_t state;
+        std::uint64_t inc;
+};
+
+
+inline rng& thread_rng() {
+    // Each thread owns its generator, so sampling never contends on shared state. Renderers
+    // reseed it per pixel to make images independent of the thread count.
+    thread_local rng generator;
+    return generator;
+}
+
+
+#endif
@@ -14,6 +14,8 @@
 #include <limits>
 #include <memory>
 
+#include "rng.h"
+
 
 // Usings
 
@@ -51,7 +53,7 @@ inline bool check_equal(double given_val, double check_val, double epsilon) {
 
 inline double random_double() {
     // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    return thread_rng().next_double();
 }
 
 inline double random_double(double min, double max) {
@@ -0,0 +1,138 @@
+#ifndef SAMPLE_STATS_H
+#define SAMPLE_STATS_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include "color.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+
+class sample_stats {
+    // Running mean and variance of the luminance of a pixel's samples, updated one sample at a
+    // time with Welford's algorithm, which stays accurate where summing squares would cancel.
+    public:
+        sample_stats() : count(0), hits(0), mean(0), m2(0) {}
+
+        // camera_hit tells whether the sample's camera ray hit anything in the scene.
+        void add(const color& sample, bool camera_hit) {
+            auto x = luminance(sample);
+            count++;
+            if (camera_hit) hits++;
+            auto delta = x - mean;
+            mean += delta / count;
+            m2 += delta * (x - mean);
+        }
+
+        double variance() const { return (count > 1) ? m2 / (count - 1) : 0; }
+
+    public:
+        int count;
+        int hits;   // Samples whose camera ray hit the scene
+        double mean;
+        double m2;  // Sum of squared differences from the mean
+};
+
+
+struct adaptive_sampling {
+    // Every pixel takes at least min_samples samples and at most max_samples. In between, it
+    // stops once the 95% confidence interval of its mean is narrower than max_error relative to
+    // the mean. Pixels darker than min_luminance are allowed the error of one at min_luminance,
+    // so near-black pixels don't run to max_samples chasing noise too faint to see. A
+    // max_error of zero turns the early stop off.
+    int min_samples;
+    int max_samples;
+    double max_error;
+    double min_luminance;
+
+    // A pixel whose paths have all missed a small light so far looks noise free, and would
+    // stop early and come out too dark. Its variance is therefore taken to be at least
+    // min_variance, which callers set from the neighboring pixels, and a variance of zero is
+    // only believed where every camera ray saw nothing but the background.
+    bool done(const sample_stats& stats, double min_variance) const {
+        if (stats.count >= max_samples) return true;
+        if (stats.count < min_samples || max_error <= 0) return false;
+        auto variance = fmax(stats.variance(), min_variance);
+        if (variance <= 0 && stats.hits > 0) return false;
+        auto error = 1.96 * sqrt(variance / stats.count);
+        return error <= max_error * fmax(stats.mean, min_luminance);
+    }
+};
+
+
+inline std::uint64_t sample_stream(std::uint64_t pixel, int sample) {
+    // The rng::seed_stream item of one sample of one pixel. The numbering doesn't depend on the
+    // most samples a pixel may take, so a render resumed with a higher cap carries on with
+    // streams no other sample has used.
+    return (pixel << 32) | static_cast<std::uint32_t>(sample);
+}
+
+
+class frame_stats {
+    // The sample statistics of every pixel of an image, and which pixels still need samples.
+    // Pixels use the same (i,j) convention as the framebuffer.
+    public:
+        frame_stats(int image_width, int image_height)
+          : width(image_width), height(image_height),
+            pixels(static_cast<size_t>(image_width) * image_height),
+            active(static_cast<size_t>(image_width) * image_height, 1)
+        {}
+
+        sample_stats& at(int i, int j)             { return pixels[index(i,j)]; }
+        const sample_stats& at(int i, int j) const { return pixels[index(i,j)]; }
+
+        bool is_active(int i, int j) const { return active[index(i,j)] != 0; }
+
+        // Retires the pixels that are done, and returns the number still active. A pixel is
+        // judged with the variance of the noisiest pixel in its run of run_width along the row.
+        int update(const adaptive_sampling& sampling);
+
+    public:
+        int width;
+        int height;
+        std::vector<sample_stats> pixels;
+        std::vector<char> active;
+
+        static const int run_width = 8;
+
+    private:
+        size_t index(int i, int j) const { return static_cast<size_t>(j)*width + i; }
+};
+
+
+int frame_stats::update(const adaptive_sampling& sampling) {
+    int remaining = 0;
+
+    for (int j = 0; j < height; ++j) {
+        for (int i0 = 0; i0 < width; i0 += run_width) {
+            const int i1 = std::min(width, i0 + run_width);
+
+            double run_variance = 0;
+            for (int i = i0; i < i1; ++i)
+                run_variance = fmax(run_variance, at(i,j).variance());
+
+            for (int i = i0; i < i1; ++i) {
+                auto& pixel_active = active[index(i,j)];
+                if (pixel_active && sampling.done(at(i,j), run_variance))
+                    pixel_active = 0;
+                if (pixel_active)
+                    remaining++;
+            }
+        }
+    }
+
+    return remaining;
+}
+
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef TILE_RENDERER_H
+#define TILE_RENDERER_H
+//==============================================================================================
+// To the extent possible under law, the author(s) have dedicated all copyright and related and
+// neighboring rights to this software to the public domain worldwide. This software is
+// distributed without any warranty.
+//
+// You should have received a copy (see file COPYING.txt) of the CC0 Public Domain Dedication
+// along with this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+//==============================================================================================
+
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+struct tile {
+    // Pixel bounds of the tile. The lower bounds are inclusive, the upper bounds exclusive.
+    int x0, y0;
+    int x1, y1;
+};
+
+
+class tile_renderer {
+    public:
+        tile_renderer(int image_width, int image_height, int tile_size = 16, int threads = 0)
+          : show_progress(true), workers(threads)
+        {
+            if (workers <= 0)
+                workers = static_cast<int>(std::thread::hardware_concurrency());
+            if (workers <= 0)
+                workers = 1;
+
+            // Tiles are listed top scanline first, matching the order the image is written in.
+            for (int y1 = image_height; y1 > 0; y1 -= tile_size) {
+                for (int x0 = 0; x0 < image_width; x0 += tile_size) {
+                    tile t;
+                    t.x0 = x0;
+                    t.y0 = std::max(0, y1 - tile_size);
+                    t.x1 = std::min(image_width, x0 + tile_size);
+                    t.y1 = y1;
+                    tiles.push_back(t);
+                }
+            }
+        }
+
+        int thread_count() const { return workers; }
+
+        // Calls render_tile(const tile&) exactly once for every tile of the image, spread over
+        // the worker threads. Each worker starts on its own contiguous run of tiles and steals
+        // from the back of the other queues once its own queue runs dry. render_tile must be
+        // safe to call concurrently for distinct tiles.
+        template <typename TileFunc>
+        void render(TileFunc render_tile) const;
+
+    public:
+        std::vector<tile> tiles;
+        bool show_progress;  // Report the tiles remaining on standard error
+
+    private:
+        struct tile_queue {
+            std::mutex mutex;
+            std::deque<tile> tiles;
+        };
+
+        static bool pop_front(tile_queue& queue, tile& t) {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tiles.empty()) return false;
+            t = queue.tiles.front();
+            queue.tiles.pop_front();
+            return true;
+        }
+
+        static bool pop_back(tile_queue& queue, tile& t) {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tiles.empty()) return false;
+            t = queue.tiles.back();
+            queue.tiles.pop_back();
+            return true;
+        }
+
+        int workers;
+};
+
+
+template <typename TileFunc>
+void tile_renderer::render(TileFunc render_tile) const {
+    const auto tile_count = tiles.size();
+    std::vector<tile_queue> queues(workers);
+
+    for (int w = 0; w < workers; ++w) {
+        auto first = tile_count * w / workers;
+        auto last  = tile_count * (w+1) / workers;
+        queues[w].tiles.assign(tiles.begin() + first, tiles.begin() + last);
+    }
+
+    std::atomic<int> tiles_remaining(static_cast<int>(tile_count));
+    std::mutex progress_mutex;
+
+    auto worker = [&](int w) {
+        tile t;
+        while (true) {
+            bool found = pop_front(queues[w], t);
+            for (int k = 1; !found && k < workers; ++k)
+                found = pop_back(queues[(w + k) % workers], t);
+
+            // Tiles are never re-queued, so once every queue is empty the work is done.
+            if (!found)
+                return;
+
+            render_tile(t);
+
+            int remaining = --tiles_remaining;
+            if (!show_progress)
+                continue;
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            std::cerr << "\rTiles remaining: " << remaining << ' ' << std::flush;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int w = 1; w < workers; ++w)
+        threads.emplace_back(worker, w);
+
+    worker(0);
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+
+#endif
@@ -17,10 +17,93 @@
 using std::sqrt;
 using std::fabs;
 
+// Build options, set through CMake (see CMakeLists.txt):
+//
+//   RTW_VEC3_FLOAT  Store the components as float rather than double. The interface still
+//                   takes and returns double, so only the storage and the arithmetic inside
+//                   vec3 lose precision.
+//   RTW_VEC3_SIMD   Pad vec3 to four lanes and do its arithmetic with SSE (float) or AVX
+//                   (double) intrinsics. Targets without the needed instruction set quietly
+//                   use the scalar code.
+
+#ifdef RTW_VEC3_FLOAT
+using vec3_real = float;
+#else
+using vec3_real = double;
+#endif
+
+#if defined(RTW_VEC3_SIMD) && defined(RTW_VEC3_FLOAT) \
+    && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define RTW_VEC3_SSE
+#include <xmmintrin.h>
+#elif defined(RTW_VEC3_SIMD) && !defined(RTW_VEC3_FLOAT) && defined(__AVX__)
+#define RTW_VEC3_AVX
+#include <immintrin.h>
+#endif
+
+
+// Four-lane helpers for the SIMD build. The fourth lane is always zero, so it drops out of
+// sums and products. Scalars are spread over the first three lanes only, since scaling the
+// zero by an infinity (or dividing by zero) would make it a NaN that then poisons every dot
+// product and length taken from the vector. Loads and stores are unaligned since C++11
+// allocators don't honor alignment beyond that of max_align_t.
+
+#if defined(RTW_VEC3_SSE)
+
+typedef __m128 vec3_lanes;
+
+inline vec3_lanes lanes_load(const float* p) { return _mm_loadu_ps(p); }
+inline void lanes_store(float* p, vec3_lanes a) { _mm_storeu_ps(p, a); }
+inline vec3_lanes lanes_scalar(float t) { return _mm_set_ps(0, t, t, t); }
+inline vec3_lanes lanes_add(vec3_lanes a, vec3_lanes b) { return _mm_add_ps(a, b); }
+inline vec3_lanes lanes_sub(vec3_lanes a, vec3_lanes b) { return _mm_sub_ps(a, b); }
+inline vec3_lanes lanes_mul(vec3_lanes a, vec3_lanes b) { return _mm_mul_ps(a, b); }
+
+inline float lanes_sum(vec3_lanes a) {
+    // (x + y) + (z + w), which with w zero is (x + y) + z, the same order as the scalar code
+    __m128 swapped = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+    __m128 pairs = _mm_add_ps(a, swapped);
+    __m128 high = _mm_movehl_ps(swapped, pairs);
+    return _mm_cvtss_f32(_mm_add_ss(pairs, high));
+}
+
+inline vec3_lanes lanes_yzx(vec3_lanes a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3,0,2,1)); }
+
+#elif defined(RTW_VEC3_AVX)
+
+typedef __m256d vec3_lanes;
+
+inline vec3_lanes lanes_load(const double* p) { return _mm256_loadu_pd(p); }
+inline void lanes_store(double* p, vec3_lanes a) { _mm256_storeu_pd(p, a); }
+inline vec3_lanes lanes_scalar(double t) { return _mm256_set_pd(0, t, t, t); }
+inline vec3_lanes lanes_add(vec3_lanes a, vec3_lanes b) { return _mm256_add_pd(a, b); }
+inline vec3_lanes lanes_sub(vec3_lanes a, vec3_lanes b) { return _mm256_sub_pd(a, b); }
+inline vec3_lanes lanes_mul(vec3_lanes a, vec3_lanes b) { return _mm256_mul_pd(a, b); }
+
+inline double lanes_sum(vec3_lanes a) {
+    // (x + z) + (y + w), which with w zero is (x + z) + y. That is not the scalar code's order,
+    // so results can differ from it in the last bit.
+    __m128d low = _mm256_castpd256_pd128(a);
+    __m128d high = _mm256_extractf128_pd(a, 1);
+    low = _mm_add_pd(low, high);
+    return _mm_cvtsd_f64(_mm_add_sd(low, _mm_unpackhi_pd(low, low)));
+}
+
+#endif
+
+#if defined(RTW_VEC3_SSE) || defined(RTW_VEC3_AVX)
+#define RTW_VEC3_LANES 4
+#else
+#define RTW_VEC3_LANES 3
+#endif
+
+
 class vec3 {
     public:
         vec3() : e{0,0,0} {}
-        vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+        vec3(double e0, double e1, double e2)
+          : e{static_cast<vec3_real>(e0), static_cast<vec3_real>(e1), static_cast<vec3_real>(e2)}
+        {}
 
         double x() const { return e[0]; }
         double y() const { return e[1]; }
@@ -28,8 +111,22 @@ class vec3 {
 
         vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
         double operator[](int i) const { return e[i]; }
-        double& operator[](int i) { return e[i]; }
+        vec3_real& operator[](int i) { return e[i]; }
+
+#if RTW_VEC3_LANES == 4
+        explicit vec3(vec3_lanes a) { lanes_store(e, a); }
+        vec3_lanes lanes() const { return lanes_load(e); }
 
+        vec3& operator+=(const vec3 &v) {
+            lanes_store(e, lanes_add(lanes(), v.lanes()));
+            return *this;
+        }
+
+        vec3& operator*=(const double t) {
+            lanes_store(e, lanes_mul(lanes(), lanes_scalar(static_cast<vec3_real>(t))));
+            return *this;
+        }
+#else
         vec3& operator+=(const vec3 &v) {
             e[0] += v.e[0];
             e[1] += v.e[1];
@@ -43,6 +140,7 @@ class vec3 {
             e[2] *= t;
             return *this;
         }
+#endif
 
         vec3& operator/=(const double t) {
             return *this *= 1/t;
@@ -53,7 +151,12 @@ class vec3 {
         }
 
         double length_squared() const {
+#if RTW_VEC3_LANES == 4
+            auto a = lanes();
+            return lanes_sum(lanes_mul(a, a));
+#else
             return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
+#endif
         }
 
         bool near_zero() const {
@@ -71,7 +174,7 @@ class vec3 {
         }
 
     public:
-        double e[3];
+        vec3_real e[RTW_VEC3_LANES];
 };
 
 
@@ -86,6 +189,26 @@ inline std::ostream& operator<<(std::ostream &out, const vec3 &v) {
     return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
+#if RTW_VEC3_LANES == 4
+
+inline vec3 operator+(const vec3 &u, const vec3 &v) {
+    return vec3(lanes_add(u.lanes(), v.lanes()));
+}
+
+inline vec3 operator-(const vec3 &u, const vec3 &v) {
+    return vec3(lanes_sub(u.lanes(), v.lanes()));
+}
+
+inline vec3 operator*(const vec3 &u, const vec3 &v) {
+    return vec3(lanes_mul(u.lanes(), v.lanes()));
+}
+
+inline vec3 operator*(double t, const vec3 &v) {
+    return vec3(lanes_mul(lanes_scalar(static_cast<vec3_real>(t)), v.lanes()));
+}
+
+#else
+
 inline vec3 operator+(const vec3 &u, const vec3 &v) {
     return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
 }
@@ -102,6 +225,8 @@ inline vec3 operator*(double t, const vec3 &v) {
     return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
 }
 
+#endif
+
 inline vec3 operator*(const vec3 &v, double t) {
     return t * v;
 }
@@ -111,15 +236,27 @@ inline vec3 operator/(vec3 v, double t) {
 }
 
 inline double dot(const vec3 &u, const vec3 &v) {
+#if RTW_VEC3_LANES == 4
+    return lanes_sum(lanes_mul(u.lanes(), v.lanes()));
+#else
     return u.e[0] * v.e[0]
          + u.e[1] * v.e[1]
          + u.e[2] * v.e[2];
+#endif
 }
 
 inline vec3 cross(const vec3 &u, const vec3 &v) {
+#if defined(RTW_VEC3_SSE)
+    // u * v.yzx - u.yzx * v gives the cross product rotated one lane, in zxy order.
+    auto a = u.lanes(), b = v.lanes();
+    auto c = lanes_sub(lanes_mul(a, lanes_yzx(b)), lanes_mul(lanes_yzx(a), b));
+    return vec3(lanes_yzx(c));
+#else
+    // AVX can't cheaply shuffle across its two 128-bit halves, so doubles stay scalar here.
     return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
                 u.e[2] * v.e[0] - u.e[0] * v.e[2],
                 u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+#endif
 }
 
 inline vec3 unit_vector(vec3 v) {